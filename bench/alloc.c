@@ -0,0 +1,381 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+// Needed for malloc_usable_size ().
+#define _GNU_SOURCE
+
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "cmd.h"
+#include "command_line.h"
+#include "object.h"
+#include "shell.h"
+#include "string.h"
+
+/**
+ * The command line parsed by the operations, of 20 words with quotes, escapes
+ * and pipes (the same as in bench/core.c).
+ **/
+#define ALLOC_COMMAND_LINE \
+	"grep -r --include='*.c' -n \"TODO: fix\" src bench tools | sort -u -k1,1" \
+	" | head -n 20 > /dev/null 2>&1 'last word' with\\ escape"
+
+/**
+ * The number of bytes malloc () may add to a block (the usable size of the
+ * blocks is counted).
+ **/
+#define ALLOC_BLOCK_SLACK 16
+
+/**
+ * The intended cost of parsing ALLOC_COMMAND_LINE: one block holding its text
+ * and its words, and the vector of its 22 items (20 words and 2 pipes), which
+ * is allocated once with 32 slots. The CommandLine reuses the memory of a
+ * destroyed one.
+ **/
+#define ALLOC_PARSE_ALLOCATIONS 2
+#define ALLOC_PARSE_BYTES \
+	(2 * sizeof (ALLOC_COMMAND_LINE) + 32 * sizeof (void *) \
+		+ ALLOC_PARSE_ALLOCATIONS * ALLOC_BLOCK_SLACK)
+
+/**
+ * The intended cost of "cd": it copies its argument and reads the current
+ * directory before and after changing it, each time with a buffer of 128
+ * bytes shrunk to the path. The lines, parsed twice, are in the parse cache of
+ * the Shell.
+ **/
+#define ALLOC_CD_ALLOCATIONS (2 * (1 + 2 * 2))
+#define ALLOC_CD_BYTES (128 + 2 * 16 + 3 * ALLOC_BLOCK_SLACK)
+
+/**
+ * The path built by alloc_string_concat ().
+ **/
+#define ALLOC_CONCAT_PATH "/home/user/.config/Shelldon/history.bin"
+
+/**
+ * The number of times each operation is measured.
+ **/
+#define ALLOC_RUNS 4
+
+/**
+ * The number of runs before the measured ones, which fill the caches (a command
+ * line enters the parse cache of the Shell when it is parsed a second time).
+ **/
+#define ALLOC_WARMUP_RUNS 2
+
+/**
+ * The allocator of the GNU C library, called by the replacements below, which
+ * are used by the whole program including the C library itself.
+ **/
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *pointer, size_t size);
+extern void __libc_free (void *pointer);
+
+/**
+ * An operation and the most allocations it may do.
+ **/
+typedef struct
+{
+	const char *name;
+	void (*function) (Shell *shell);
+
+	/**
+	 * The maximum number of calls to malloc (), calloc () and realloc ().
+	 **/
+	size_t max_allocations;
+
+	/**
+	 * The maximum number of bytes allocated at once, beyond what was allocated
+	 * before the operation.
+	 **/
+	size_t max_peak_bytes;
+} alloc_operation_t;
+
+/**
+ * True while the allocations are counted.
+ **/
+static bool counting = false;
+
+static size_t n_allocations = 0;
+
+/**
+ * The number of bytes allocated since the counting has started (negative if
+ * more has been freed), and its maximum.
+ **/
+static int64_t live_bytes = 0;
+static int64_t peak_bytes = 0;
+
+static void
+alloc_count (void *old_pointer, void *new_pointer)
+{
+	if (!counting)
+	{
+		return;
+	}
+	if (new_pointer)
+	{
+		++n_allocations;
+		live_bytes += (int64_t) malloc_usable_size (new_pointer);
+	}
+	if (old_pointer)
+	{
+		live_bytes -= (int64_t) malloc_usable_size (old_pointer);
+	}
+	if (live_bytes > peak_bytes)
+	{
+		peak_bytes = live_bytes;
+	}
+}
+
+void *
+malloc (size_t size)
+{
+	void *pointer = __libc_malloc (size);
+	alloc_count (NULL, pointer);
+	return pointer;
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+	void *pointer = __libc_calloc (n, size);
+	alloc_count (NULL, pointer);
+	return pointer;
+}
+
+void *
+realloc (void *pointer, size_t size)
+{
+	// The old size is needed after the block has been moved.
+	int64_t old_size = (pointer ? (int64_t) malloc_usable_size (pointer) : 0);
+	void *new_pointer = __libc_realloc (pointer, size);
+	if (counting && new_pointer)
+	{
+		live_bytes -= old_size;
+		alloc_count (NULL, new_pointer);
+	}
+	return new_pointer;
+}
+
+void
+free (void *pointer)
+{
+	alloc_count (pointer, NULL);
+	__libc_free (pointer);
+}
+
+static void
+alloc_command_line_new (Shell *shell)
+{
+	object_unref (command_line_new (ALLOC_COMMAND_LINE));
+}
+
+/**
+ * Parses a command line found in the cache of the Shell.
+ **/
+static void
+alloc_shell_parse (Shell *shell)
+{
+	object_unref (shell_parse (shell, ALLOC_COMMAND_LINE));
+}
+
+/**
+ * Parses a command line which has never been parsed, so it is built in the
+ * arena of the Shell.
+ **/
+static void
+alloc_shell_parse_new (Shell *shell)
+{
+	static unsigned long n = 0;
+	char line[sizeof (ALLOC_COMMAND_LINE) + 24];
+	snprintf (line, sizeof (line), "%s %lu", ALLOC_COMMAND_LINE, n++);
+	object_unref (shell_parse (shell, line));
+}
+
+/**
+ * Runs "cd" as the main loop does, to a directory and back.
+ **/
+static void
+alloc_cd (Shell *shell)
+{
+	CommandLine *command_line = shell_parse (shell, "cd /");
+	shell_execute_command_line (shell, command_line, NULL);
+	object_unref (command_line);
+	command_line = shell_parse (shell, "cd /tmp");
+	shell_execute_command_line (shell, command_line, NULL);
+	object_unref (command_line);
+}
+
+static void
+alloc_string_from_integer (Shell *shell)
+{
+	object_unref (string_from_integer (-1234567890, 10));
+}
+
+static void
+alloc_string_concat (Shell *shell)
+{
+	free (string_concat (NULL, "/home/user/.config", "/", "Shelldon",
+		"/history.bin", NULL));
+}
+
+static void
+alloc_array_append (Shell *shell)
+{
+	Array *array = array_new (NULL);
+	for (size_t i = 0; i < 100; ++i)
+	{
+		array_append (array, (void *) i);
+	}
+	object_unref (array);
+}
+
+static void
+alloc_object_new (Shell *shell)
+{
+	object_unref (object_new ());
+}
+
+/**
+ * The operations and their budgets: what they are intended to cost, which is
+ * what the code should be fixed to meet, not what it happens to cost.
+ *
+ * A command line read by the Shell costs nothing: it is either in its parse
+ * cache or built in its arena. Objects and the Strings of integers reuse the
+ * memory of destroyed ones. An Array grows by doubling its capacity from 16
+ * items.
+ **/
+static const alloc_operation_t operations[] = {
+	{ "command_line_new (20 words)", alloc_command_line_new,
+		ALLOC_PARSE_ALLOCATIONS, ALLOC_PARSE_BYTES },
+	{ "shell_parse (cached)", alloc_shell_parse, 0, 0 },
+	{ "shell_parse (new, 21 words)", alloc_shell_parse_new, 0, 0 },
+	{ "cd / && cd /tmp", alloc_cd, ALLOC_CD_ALLOCATIONS, ALLOC_CD_BYTES },
+	{ "string_from_integer", alloc_string_from_integer, 0, 0 },
+	{ "string_concat", alloc_string_concat, 1,
+		sizeof (ALLOC_CONCAT_PATH) + ALLOC_BLOCK_SLACK },
+	{ "array_append (100 items)", alloc_array_append, 4,
+		128 * sizeof (void *) + ALLOC_BLOCK_SLACK },
+	{ "object_new", alloc_object_new, 0, 0 }
+};
+
+#define N_OPERATIONS (sizeof (operations) / sizeof (*operations))
+
+/**
+ * The number of temporary Strings created by alloc_check_string_reuse ().
+ **/
+#define ALLOC_REUSE_RUNS 1000
+
+/**
+ * Checks that temporary Strings, created and destroyed one at a time while no
+ * other String is alive, all reuse the memory of the previous one.
+ **/
+static bool
+alloc_check_string_reuse (void)
+{
+	object_unref (string_from_integer (1, 10));
+
+	// The class is only referenced while the counters are read.
+	StringClass *klass = string_class_get ();
+	unsigned long n_constructed = object_class_get_n_constructed (klass);
+	unsigned long n_reused = object_class_get_n_reused (klass);
+	object_class_unref (klass);
+
+	for (int i = 0; i < ALLOC_REUSE_RUNS; ++i)
+	{
+		object_unref (string_from_integer (i, 10));
+	}
+
+	klass = string_class_get ();
+	n_constructed = object_class_get_n_constructed (klass) - n_constructed;
+	n_reused = object_class_get_n_reused (klass) - n_reused;
+	object_class_unref (klass);
+
+	bool reused = (ALLOC_REUSE_RUNS == n_constructed && n_reused == n_constructed);
+	printf ("Temporary Strings: %lu of %lu reused the memory of the previous"
+		" one%s\n\n", n_reused, n_constructed, (reused ? "" : "  NOT REUSED"));
+
+	return reused;
+}
+
+int
+main (int argc, char **argv)
+{
+	// Done first, while the Shell does not keep any String alive.
+	int result = (alloc_check_string_reuse () ? EXIT_SUCCESS : EXIT_FAILURE);
+
+	printf ("%-36s %12s %8s %12s %8s\n", "operation", "allocations", "budget",
+		"peak bytes", "budget");
+
+	char *cwd = getcwd (NULL, 0);
+	Shell *shell = shell_new ("shelldon-alloc");
+	shell_add_command (shell, "cd", cmd_cd, "[DIR]", NULL);
+
+	for (size_t i = 0; i < N_OPERATIONS; ++i)
+	{
+		const alloc_operation_t *operation = operations + i;
+		for (int run = 0; run < ALLOC_WARMUP_RUNS; ++run)
+		{
+			operation->function (shell);
+		}
+
+		size_t max_allocations = 0;
+		int64_t max_peak_bytes = 0;
+		for (int run = 0; run < ALLOC_RUNS; ++run)
+		{
+			n_allocations = 0;
+			live_bytes = peak_bytes = 0;
+			counting = true;
+			operation->function (shell);
+			counting = false;
+
+			if (n_allocations > max_allocations)
+			{
+				max_allocations = n_allocations;
+			}
+			if (peak_bytes > max_peak_bytes)
+			{
+				max_peak_bytes = peak_bytes;
+			}
+		}
+
+		bool exceeded = (max_allocations > operation->max_allocations
+			|| max_peak_bytes > (int64_t) operation->max_peak_bytes);
+		printf ("%-36s %12zu %8zu %12zu %8zu%s\n", operation->name,
+			max_allocations, operation->max_allocations, (size_t) max_peak_bytes,
+			operation->max_peak_bytes, (exceeded ? "  OVER BUDGET" : ""));
+		if (exceeded)
+		{
+			result = EXIT_FAILURE;
+		}
+	}
+
+	object_unref (shell);
+	if (cwd && -1 == chdir (cwd))
+	{
+		perror (cwd);
+	}
+	free (cwd);
+
+	return result;
+}
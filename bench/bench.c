@@ -0,0 +1,215 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+// Needed for sched_setaffinity () and sched_getcpu ().
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+/**
+ * The maximum number of operations of a repetition.
+ **/
+#define MAX_OPERATIONS ((size_t) 1 << 30)
+
+volatile size_t bench_sink = 0;
+
+static unsigned int repetitions = 100;
+
+static unsigned int warmup = 5;
+
+static uint64_t repetition_duration = 1000 * 1000;
+
+static char **filters = NULL;
+
+static int n_filters = 0;
+
+static int
+bench_compare (const void *a, const void *b);
+
+static uint64_t
+bench_time (bench_func_t function, void *data, size_t n);
+
+void
+bench_init (int argc, char **argv)
+{
+	int cpu = sched_getcpu ();
+	int opt;
+	while (-1 != (opt = getopt (argc, argv, "c:r:t:w:")))
+	{
+		switch (opt)
+		{
+			case 'c':
+				cpu = atoi (optarg);
+				break;
+			case 'r':
+				repetitions = (unsigned int) atoi (optarg);
+				break;
+			case 't':
+				repetition_duration = (uint64_t) atoll (optarg) * 1000;
+				break;
+			case 'w':
+				warmup = (unsigned int) atoi (optarg);
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-c CPU] [-r REPETITIONS] [-w WARMUP]"
+					" [-t US] [NAME...]\n", argv[0]);
+				exit (EXIT_FAILURE);
+		}
+	}
+	if (!repetitions)
+	{
+		repetitions = 1;
+	}
+	filters = argv + optind;
+	n_filters = argc - optind;
+
+	// The caches and the frequency of a CPU are not shared with the others.
+	if (cpu >= 0)
+	{
+		cpu_set_t set;
+		CPU_ZERO (&set);
+		CPU_SET (cpu, &set);
+		if (-1 == sched_setaffinity (0, sizeof (set), &set))
+		{
+			perror ("sched_setaffinity");
+		}
+	}
+
+	fprintf (stderr, "%-32s %12s %12s %12s %12s\n", "benchmark", "median", "p99",
+		"min", "mean");
+}
+
+bool
+bench_is_selected (const char *name)
+{
+	for (int i = 0; i < n_filters; ++i)
+	{
+		if (strstr (name, filters[i]))
+		{
+			return true;
+		}
+	}
+
+	return (0 == n_filters);
+}
+
+void
+bench_run (const char *name, bench_func_t function, void *data)
+{
+	if (!bench_is_selected (name))
+	{
+		return;
+	}
+
+	size_t n = 1;
+	while (bench_time (function, data, n) < repetition_duration
+		&& n < MAX_OPERATIONS)
+	{
+		n *= 2;
+	}
+	for (unsigned int i = 0; i < warmup; ++i)
+	{
+		bench_time (function, data, n);
+	}
+
+	double *samples = malloc (sizeof (double) * repetitions);
+	if (!samples)
+	{
+		abort ();
+	}
+	for (unsigned int i = 0; i < repetitions; ++i)
+	{
+		samples[i] = (double) bench_time (function, data, n) / (double) n;
+	}
+	bench_report (name, "ns", samples, repetitions);
+	free (samples);
+}
+
+void
+bench_report (const char *name, const char *unit, double *samples, size_t n)
+{
+	qsort (samples, n, sizeof (double), bench_compare);
+
+	double sum = 0;
+	for (size_t i = 0; i < n; ++i)
+	{
+		sum += samples[i];
+	}
+	double median = bench_get_percentile (samples, n, 50);
+	double p99 = bench_get_percentile (samples, n, 99);
+
+	printf ("{\"benchmark\": \"%s\", \"unit\": \"%s\", \"samples\": %zu, "
+		"\"median\": %.3f, \"p99\": %.3f, \"min\": %.3f, \"mean\": %.3f}\n",
+		name, unit, n, median, p99, samples[0], sum / n);
+	fflush (stdout);
+	fprintf (stderr, "%-32s %9.1f %-2s %9.1f %-2s %9.1f %-2s %9.1f %-2s\n", name,
+		median, unit, p99, unit, samples[0], unit, sum / n, unit);
+}
+
+void
+bench_report_value (const char *name, const char *unit, double value)
+{
+	printf ("{\"benchmark\": \"%s\", \"unit\": \"%s\", \"value\": %.3f}\n",
+		name, unit, value);
+	fflush (stdout);
+	fprintf (stderr, "%-32s %9.1f %s\n", name, value, unit);
+}
+
+double
+bench_get_percentile (const double *samples, size_t n, double p)
+{
+	// The nearest rank.
+	size_t rank = (size_t) ceil (p / 100 * n);
+	return samples[(rank ? rank - 1 : 0)];
+}
+
+uint64_t
+bench_now (void)
+{
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static int
+bench_compare (const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Returns the duration of "n" runs of "function", in nanoseconds.
+ **/
+static uint64_t
+bench_time (bench_func_t function, void *data, size_t n)
+{
+	uint64_t start = bench_now ();
+	function (data, n);
+	return bench_now () - start;
+}
@@ -0,0 +1,119 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SHELLDON_BENCH_H
+#define SHELLDON_BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * A benchmarked operation, which must be run "n" times.
+ **/
+typedef void (*bench_func_t) (void *data, size_t n);
+
+/**
+ * Parses the options of a benchmark program and pins it to a CPU:
+ *
+ * - "-c CPU" sets the CPU (by default the one we are running on, -1 to not
+ *   pin the program);
+ * - "-r N" sets the number of measured repetitions (100 by default);
+ * - "-w N" sets the number of repetitions run before (5 by default);
+ * - "-t US" sets the duration of a repetition in microseconds (1000 by
+ *   default);
+ * - the other arguments are substrings of the names of the benchmarks to run
+ *   (all of them by default).
+ *
+ * @param argc The number of arguments.
+ * @param argv The arguments of the program.
+ **/
+void
+bench_init (int argc, char **argv);
+
+/**
+ * Returns true if the benchmark "name" has been selected by the arguments of
+ * the program.
+ *
+ * @param name The name of the benchmark.
+ * @return True if it must be run.
+ **/
+bool
+bench_is_selected (const char *name);
+
+/**
+ * Measures the duration of an operation: "function" is first run with an
+ * increasing "n" until it lasts the duration of a repetition, then the warmup
+ * repetitions are run and the measured ones are reported (in nanoseconds per
+ * operation) with bench_report ().
+ *
+ * @param name     The name of the benchmark.
+ * @param function The operation.
+ * @param data     The argument of "function".
+ **/
+void
+bench_run (const char *name, bench_func_t function, void *data);
+
+/**
+ * Prints the median, 99th percentile, minimum and mean of "samples" (which are
+ * sorted in place): a JSON object per line on the standard output, for the
+ * tools, and a table on the error output.
+ *
+ * @param name    The name of the benchmark.
+ * @param unit    The unit of the samples (e.g. "ns").
+ * @param samples The samples.
+ * @param n       The number of samples (must be greater than 0).
+ **/
+void
+bench_report (const char *name, const char *unit, double *samples, size_t n);
+
+/**
+ * Prints a single value (e.g. a throughput): a JSON object on the standard
+ * output and a line on the error output.
+ *
+ * @param name  The name of the benchmark.
+ * @param unit  The unit of the value.
+ * @param value The value.
+ **/
+void
+bench_report_value (const char *name, const char *unit, double value);
+
+/**
+ * Returns the value below which "p" percent of the sorted samples are.
+ *
+ * @param samples The sorted samples.
+ * @param n       The number of samples (must be greater than 0).
+ * @param p       The percentage.
+ * @return The percentile.
+ **/
+double
+bench_get_percentile (const double *samples, size_t n, double p);
+
+/**
+ * Returns the current time of a monotonic clock.
+ *
+ * @return The time in nanoseconds.
+ **/
+uint64_t
+bench_now (void);
+
+/**
+ * Written by the benchmarks so that their results are not optimized away.
+ **/
+extern volatile size_t bench_sink;
+
+#endif
@@ -0,0 +1,356 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#include "array.h"
+#include "command_line.h"
+#include "object.h"
+#include "shell.h"
+#include "string.h"
+#include "tools.h"
+
+/**
+ * A command line of 20 words, with quotes, escapes and a pipe.
+ **/
+#define BENCH_COMMAND_LINE \
+	"grep -r --include='*.c' -n \"TODO: fix\" src bench tools | sort -u -k1,1" \
+	" | head -n 20 > /dev/null 2>&1 'last word' with\\ escape"
+
+/**
+ * The length of the generated command lines parsed to measure the throughput
+ * of the tokenizer.
+ **/
+#define BENCH_LONG_LINE_LENGTH (4 * 1024 * 1024)
+
+/**
+ * The number of times a generated command line is parsed.
+ **/
+#define BENCH_LONG_LINE_RUNS 20
+
+/**
+ * The memory used by the process when the latency of execute () is measured
+ * again, since the cost of fork () grows with it.
+ **/
+#define BENCH_EXECUTE_MEMORY (256 * 1024 * 1024)
+
+/**
+ * The names of the builtins of bin/shelldon.
+ **/
+static const char *const command_names[] = {
+	"bg", "cd", "fg", "hash", "history", "exec", "execbg", "execfg", "exit",
+	"help", "jobs", "profile", "pwd", "setenv", "stats", "time", "version",
+	"sdc", "wait"
+};
+
+#define N_COMMAND_NAMES (sizeof (command_names) / sizeof (*command_names))
+
+static void
+bench_array_append (void *data, size_t n)
+{
+	Array *array = array_new (NULL);
+	for (size_t i = 0; i < n; ++i)
+	{
+		array_append (array, (void *) i);
+	}
+	bench_sink += array_get_size (array);
+	object_unref (array);
+}
+
+/**
+ * Removes the middle item of an Array of 1024 items, and appends one back.
+ **/
+static void
+bench_array_remove_at (void *data, size_t n)
+{
+	Array *array = data;
+	for (size_t i = 0; i < n; ++i)
+	{
+		array_remove_at (array, array_get_size (array) / 2);
+		array_append (array, (void *) i);
+	}
+	bench_sink += array_get_size (array);
+}
+
+static void
+bench_string_append_n (void *data, size_t n)
+{
+	String *string = data;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (string_get_length (string) > 4096)
+		{
+			string_clear (string);
+		}
+		string_append_n (string, "/usr/local/bin", 8);
+	}
+	bench_sink += string_get_length (string);
+}
+
+static void
+bench_string_append_char (void *data, size_t n)
+{
+	String *string = data;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if (string_get_length (string) > 4096)
+		{
+			string_clear (string);
+		}
+		string_append_char (string, 'a' + (char) (i & 15));
+	}
+	bench_sink += string_get_length (string);
+}
+
+static void
+bench_string_concat (void *data, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		char *path = string_concat (NULL, "/home/user/.config", "/", "Shelldon",
+			"/history.bin", NULL);
+		bench_sink += (size_t) path[i & 15];
+		free (path);
+	}
+}
+
+static void
+bench_string_from_integer (void *data, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		String *string = string_from_integer ((int64_t) (i * 7919) - 100000, 10);
+		bench_sink += string_get_length (string);
+		object_unref (string);
+	}
+}
+
+static void
+bench_object_construct_unref (void *data, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		Object *object = object_new ();
+		bench_sink += (size_t) object;
+		object_unref (object);
+	}
+}
+
+static void
+bench_shell_parse_command_line (void *data, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		Array *words = shell_parse_command_line (BENCH_COMMAND_LINE);
+		bench_sink += array_get_size (words);
+		object_unref (words);
+	}
+}
+
+/**
+ * Looks up the builtins in turn, and a name which is not one every 4 lookups.
+ **/
+static void
+bench_shell_get_command (void *data, size_t n)
+{
+	Shell *shell = data;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const char *name = (i & 3 ? command_names[i % N_COMMAND_NAMES] : "ls");
+		bench_sink += (size_t) shell_get_command (shell, name);
+	}
+}
+
+/**
+ * Returns a command line made of copies of "word", as long as possible
+ * without exceeding "length" bytes.
+ *
+ * @param word   The word (with its separator).
+ * @param length The maximum length of the command line.
+ * @return The command line, to free.
+ **/
+static char *
+bench_new_long_line (const char *word, size_t length)
+{
+	size_t word_length = strlen (word);
+	char *line = malloc (length + 1);
+	if (!line)
+	{
+		abort ();
+	}
+	char *p = line;
+	for (size_t i = 0; i < length / word_length; ++i)
+	{
+		memcpy (p, word, word_length);
+		p += word_length;
+	}
+	*p = '\0';
+	return line;
+}
+
+/**
+ * Parses a generated multi-megabyte command line with command_line_new ()
+ * and shell_parse (), and reports the duration of a parse and the throughput
+ * of the tokenizer (from the median duration).
+ *
+ * @param shell The Shell.
+ * @param name  The name of the benchmark.
+ * @param word  The word repeated in the command line.
+ **/
+static void
+bench_parse_long_line (Shell *shell, const char *name, const char *word)
+{
+	char *line = bench_new_long_line (word, BENCH_LONG_LINE_LENGTH);
+	size_t length = strlen (line);
+	double samples[BENCH_LONG_LINE_RUNS];
+	char full_name[64];
+
+	for (int in_shell = 0; in_shell < 2; ++in_shell)
+	{
+		snprintf (full_name, sizeof (full_name), "%s %s",
+			(in_shell ? "shell_parse" : "command_line_new"), name);
+		if (!bench_is_selected (full_name))
+		{
+			continue;
+		}
+
+		for (size_t i = 0; i < BENCH_LONG_LINE_RUNS; ++i)
+		{
+			uint64_t start = bench_now ();
+			CommandLine *command_line = (in_shell ? shell_parse (shell, line)
+				: command_line_new (line));
+			samples[i] = (double) (bench_now () - start) / 1e6;
+			bench_sink += array_get_size (ARRAY (command_line));
+			object_unref (command_line);
+		}
+		bench_report (full_name, "ms", samples, BENCH_LONG_LINE_RUNS);
+
+		double median = bench_get_percentile (samples, BENCH_LONG_LINE_RUNS, 50);
+		snprintf (full_name, sizeof (full_name), "%s %s throughput",
+			(in_shell ? "shell_parse" : "command_line_new"), name);
+		bench_report_value (full_name, "MB/s",
+			length / 1e6 / (median / 1e3));
+	}
+
+	free (line);
+}
+
+/**
+ * Runs /bin/true in foreground with execute ().
+ **/
+static void
+bench_execute (void *data, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+	{
+		int status;
+		bench_sink += (size_t) execute ("/bin/true", data, EXEC_FG, &status);
+	}
+}
+
+/**
+ * Measures the latency of execute () with posix_spawn () and with fork ().
+ *
+ * @param suffix The suffix of the names of the benchmarks.
+ **/
+static void
+bench_execute_backends (const char *suffix)
+{
+	Array *args = array_new (NULL);
+	array_append (args, "true");
+
+	static const char *const names[] = {"posix_spawn", "fork"};
+	static const spawn_backend backends[] = {SPAWN_POSIX, SPAWN_FORK};
+	char name[64];
+	for (size_t i = 0; i < 2; ++i)
+	{
+		snprintf (name, sizeof (name), "execute %s%s", names[i], suffix);
+		set_spawn_backend (backends[i]);
+		bench_run (name, bench_execute, args);
+	}
+	set_spawn_backend (SPAWN_POSIX);
+
+	object_unref (args);
+}
+
+static int
+bench_command (Shell *shell, void *args)
+{
+	return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+	bench_init (argc, argv);
+
+	bench_run ("array_append", bench_array_append, NULL);
+
+	Array *array = array_new (NULL);
+	for (size_t i = 0; i < 1024; ++i)
+	{
+		array_append (array, (void *) i);
+	}
+	bench_run ("array_remove_at", bench_array_remove_at, array);
+	object_unref (array);
+
+	String *string = string_new ();
+	bench_run ("string_append_n", bench_string_append_n, string);
+	string_clear (string);
+	bench_run ("string_append_char", bench_string_append_char, string);
+	object_unref (string);
+
+	bench_run ("string_concat", bench_string_concat, NULL);
+	bench_run ("string_from_integer", bench_string_from_integer, NULL);
+	bench_run ("object_construct_unref", bench_object_construct_unref, NULL);
+	bench_run ("shell_parse_command_line", bench_shell_parse_command_line, NULL);
+
+	Shell *shell = shell_new ("shelldon-bench");
+	for (size_t i = 0; i < N_COMMAND_NAMES; ++i)
+	{
+		shell_add_command (shell, command_names[i], bench_command, NULL, NULL);
+	}
+	bench_run ("shell_get_command", bench_shell_get_command, shell);
+
+	// Plain words are copied in runs, the others must be unescaped.
+	bench_parse_long_line (shell, "plain", "/usr/local/share/shelldon ");
+	bench_parse_long_line (shell, "quoted",
+		"'single quoted' \"double \\\"quoted\\\"\" escaped\\ word ");
+	object_unref (shell);
+
+	// The page tables copied by fork () grow with the memory in use.
+	bench_execute_backends ("");
+	if (bench_is_selected ("execute"))
+	{
+		char *memory = malloc (BENCH_EXECUTE_MEMORY);
+		if (!memory)
+		{
+			abort ();
+		}
+		memset (memory, 1, BENCH_EXECUTE_MEMORY);
+		bench_execute_backends (" 256 MiB");
+		bench_sink += (size_t) memory[BENCH_EXECUTE_MEMORY - 1];
+		free (memory);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,564 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+// Needed for forkpty (), memmem () and nftw ().
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+/**
+ * How long the shell may take to answer a keystroke before the benchmark
+ * fails, in milliseconds.
+ **/
+#define TIMEOUT 10000
+
+/**
+ * How long the shell must stay quiet for its output to be considered complete,
+ * in milliseconds.
+ **/
+#define QUIET 20
+
+/**
+ * What ends the default prompt once readline has removed its markers.
+ **/
+#define PROMPT_END ">\033[0m "
+
+/**
+ * The number of command lines kept by readline (see HISTORY_SIZE in shell.c):
+ * only that many can be recalled with the arrow keys.
+ **/
+#define READLINE_HISTORY_SIZE 1000
+
+/**
+ * The line typed, one character at a time, by keys_type ().
+ **/
+#define TYPED_LINE "true the quick brown fox jumps over the lazy dog"
+
+/**
+ * The format of the command lines of the history, from their number.
+ **/
+#define KEYS_HISTORY_LINE "make -C project%zu target-%06zu"
+
+/**
+ * The size of the buffer holding the output of the shell.
+ **/
+#define OUTPUT_SIZE 65536
+
+/**
+ * A shell run interactively on a pseudo-terminal.
+ **/
+typedef struct
+{
+	pid_t pid;
+
+	/**
+	 * The master side of the terminal.
+	 **/
+	int fd;
+
+	/**
+	 * The output received since the last keystroke.
+	 **/
+	char output[OUTPUT_SIZE];
+	size_t length;
+} keys_shell_t;
+
+static size_t n_history = 100000;
+static size_t n_files = 5000;
+static size_t n_keys = 500;
+static const char *shell_path = NULL;
+
+/**
+ * The temporary directory holding the configuration of the shell and the files
+ * it completes.
+ **/
+static char directory[] = "/tmp/shelldon-keys-XXXXXX";
+
+static void
+keys_prepare (void);
+
+static void
+keys_start_shell (keys_shell_t *shell);
+
+static void
+keys_stop_shell (keys_shell_t *shell);
+
+static void
+keys_send (keys_shell_t *shell, const char *keys);
+
+static void
+keys_wait (keys_shell_t *shell, const char *expected);
+
+static double
+keys_measure (keys_shell_t *shell, const char *keys, const char *expected);
+
+static void
+keys_reset (keys_shell_t *shell);
+
+static void
+keys_type (keys_shell_t *shell);
+
+static void
+keys_recall (keys_shell_t *shell);
+
+static void
+keys_search (keys_shell_t *shell);
+
+static void
+keys_complete (keys_shell_t *shell);
+
+static void
+keys_remove_directory (void);
+
+static int
+keys_remove (const char *path, const struct stat *st, int flag,
+	struct FTW *ftw);
+
+int
+main (int argc, char **argv)
+{
+	shell_path = "bin/shelldon";
+	int opt;
+	while (-1 != (opt = getopt (argc, argv, "f:h:n:s:")))
+	{
+		if ('f' == opt)
+		{
+			n_files = (size_t) atol (optarg);
+		}
+		else if ('h' == opt)
+		{
+			n_history = (size_t) atol (optarg);
+		}
+		else if ('n' == opt)
+		{
+			n_keys = (size_t) atol (optarg);
+		}
+		else if ('s' == opt)
+		{
+			shell_path = optarg;
+		}
+		else
+		{
+			fprintf (stderr, "Usage: %s [-f FILES] [-h HISTORY_LINES] [-n KEYS]"
+				" [-s SHELL]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (n_files < 10 || n_history < 1 || n_keys < 1)
+	{
+		fprintf (stderr, "There must be at least 10 files, 1 history line and"
+			" 1 keystroke.\n");
+		return EXIT_FAILURE;
+	}
+
+	// The shell is run from the temporary directory.
+	char *path = realpath (shell_path, NULL);
+	if (!path)
+	{
+		perror (shell_path);
+		return EXIT_FAILURE;
+	}
+	shell_path = path;
+
+	if (!mkdtemp (directory))
+	{
+		perror (directory);
+		return EXIT_FAILURE;
+	}
+	atexit (keys_remove_directory);
+	keys_prepare ();
+
+	fprintf (stderr, "%-32s %12s %12s %12s %12s\n", "benchmark", "median", "p99",
+		"min", "mean");
+
+	keys_shell_t *shell = malloc (sizeof (keys_shell_t));
+	uint64_t start = bench_now ();
+	keys_start_shell (shell);
+	keys_wait (shell, PROMPT_END);
+	bench_report_value ("keys startup", "ms",
+		(double) (bench_now () - start) / 1e6);
+
+	// The history is recalled first, before any line is added to it.
+	keys_recall (shell);
+	keys_search (shell);
+	keys_complete (shell);
+	keys_type (shell);
+
+	keys_stop_shell (shell);
+	free (shell);
+	free (path);
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * Creates the files to complete, in "directory/files", and the history of the
+ * shell, in "directory/config", through the shell itself.
+ **/
+static void
+keys_prepare (void)
+{
+	char path[sizeof (directory) + 64];
+	snprintf (path, sizeof (path), "%s/files", directory);
+	mkdir (path, 0777);
+	for (size_t i = 0; i < n_files; ++i)
+	{
+		snprintf (path, sizeof (path), "%s/files/completion-%05zu.txt",
+			directory, i);
+		int fd = open (path, O_WRONLY | O_CREAT, 0666);
+		if (-1 == fd)
+		{
+			perror (path);
+			exit (EXIT_FAILURE);
+		}
+		close (fd);
+	}
+
+	// Each line is distinct so that the line recalled by each keystroke is
+	// known.
+	snprintf (path, sizeof (path), "%s/lines", directory);
+	FILE *stream = fopen (path, "w");
+	if (!stream)
+	{
+		perror (path);
+		exit (EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < n_history; ++i)
+	{
+		fprintf (stream, KEYS_HISTORY_LINE "\n", i % 97, i);
+	}
+	fclose (stream);
+
+	char config[sizeof (directory) + 16];
+	snprintf (config, sizeof (config), "%s/config", directory);
+	mkdir (config, 0777);
+	setenv ("HOME", directory, 1);
+	setenv ("XDG_CONFIG_HOME", config, 1);
+	setenv ("INPUTRC", "/dev/null", 1);
+	setenv ("TERM", "xterm", 1);
+
+	char command[sizeof (path) + 16];
+	snprintf (command, sizeof (command), "history -r %s", path);
+	pid_t pid = fork ();
+	if (0 == pid)
+	{
+		execl (shell_path, shell_path, "-c", command, (char *) NULL);
+		perror (shell_path);
+		_exit (EXIT_FAILURE);
+	}
+	int status;
+	if (-1 == pid || -1 == waitpid (pid, &status, 0) || !WIFEXITED (status)
+		|| WEXITSTATUS (status))
+	{
+		fprintf (stderr, "Unable to import the history.\n");
+		exit (EXIT_FAILURE);
+	}
+}
+
+static void
+keys_start_shell (keys_shell_t *shell)
+{
+	// Wide enough for the lines not to wrap.
+	struct winsize size = { .ws_row = 50, .ws_col = 500 };
+	shell->length = 0;
+	shell->pid = forkpty (&shell->fd, NULL, NULL, &size);
+	if (-1 == shell->pid)
+	{
+		perror ("forkpty");
+		exit (EXIT_FAILURE);
+	}
+	if (0 == shell->pid)
+	{
+		char files[sizeof (directory) + 8];
+		snprintf (files, sizeof (files), "%s/files", directory);
+		if (-1 == chdir (files))
+		{
+			perror (files);
+			_exit (EXIT_FAILURE);
+		}
+		execl (shell_path, shell_path, (char *) NULL);
+		perror (shell_path);
+		_exit (EXIT_FAILURE);
+	}
+}
+
+static void
+keys_stop_shell (keys_shell_t *shell)
+{
+	keys_send (shell, "exit\n");
+	waitpid (shell->pid, NULL, 0);
+	close (shell->fd);
+}
+
+/**
+ * Writes keystrokes to the terminal and forgets the output received so far.
+ **/
+static void
+keys_send (keys_shell_t *shell, const char *keys)
+{
+	shell->length = 0;
+	size_t length = strlen (keys);
+	while (length)
+	{
+		ssize_t n = write (shell->fd, keys, length);
+		if (-1 == n)
+		{
+			if (EINTR == errno)
+			{
+				continue;
+			}
+			perror ("Unable to write to the shell");
+			exit (EXIT_FAILURE);
+		}
+		keys += n;
+		length -= (size_t) n;
+	}
+}
+
+/**
+ * Reads the output of the shell until it contains "expected".
+ **/
+static void
+keys_wait (keys_shell_t *shell, const char *expected)
+{
+	size_t expected_length = strlen (expected);
+	while (!memmem (shell->output, shell->length, expected, expected_length))
+	{
+		struct pollfd fds = { shell->fd, POLLIN, 0 };
+		if (poll (&fds, 1, TIMEOUT) <= 0)
+		{
+			fprintf (stderr, "The shell does not answer (expecting \"%s\").\n",
+				expected);
+			fwrite (shell->output, 1, shell->length, stderr);
+			exit (EXIT_FAILURE);
+		}
+
+		// Only the end of the output is kept.
+		if (shell->length > OUTPUT_SIZE / 2)
+		{
+			memmove (shell->output, shell->output + shell->length - expected_length,
+				expected_length);
+			shell->length = expected_length;
+		}
+		ssize_t n = read (shell->fd, shell->output + shell->length,
+			OUTPUT_SIZE - shell->length);
+		if (n <= 0)
+		{
+			fprintf (stderr, "The shell has stopped.\n");
+			exit (EXIT_FAILURE);
+		}
+		shell->length += (size_t) n;
+	}
+}
+
+/**
+ * Returns how long the shell takes to answer "keys" with "expected", in
+ * microseconds.
+ **/
+static double
+keys_measure (keys_shell_t *shell, const char *keys, const char *expected)
+{
+	uint64_t start = bench_now ();
+	keys_send (shell, keys);
+	keys_wait (shell, expected);
+	return (double) (bench_now () - start) / 1000;
+}
+
+/**
+ * Discards the line being edited, runs the empty line and waits until the
+ * shell has written the whole prompt.
+ **/
+static void
+keys_reset (keys_shell_t *shell)
+{
+	keys_send (shell, "\007\025\n");
+	keys_wait (shell, PROMPT_END);
+
+	struct pollfd fds = { shell->fd, POLLIN, 0 };
+	while (poll (&fds, 1, QUIET) > 0)
+	{
+		if (read (shell->fd, shell->output, OUTPUT_SIZE) <= 0)
+		{
+			break;
+		}
+	}
+	shell->length = 0;
+}
+
+/**
+ * Types lines one character at a time, measuring the echo of each one, then
+ * runs them.
+ **/
+static void
+keys_type (keys_shell_t *shell)
+{
+	double *samples = malloc (sizeof (double) * n_keys);
+	size_t n_lines = 0;
+	double *line_samples = malloc (sizeof (double) * (n_keys / 4 + 1));
+	for (size_t i = 0, j = 0; i < n_keys; ++i)
+	{
+		char key[2] = { TYPED_LINE[j++], '\0' };
+		samples[i] = keys_measure (shell, key, key);
+		if (!TYPED_LINE[j] || i + 1 == n_keys)
+		{
+			line_samples[n_lines++] = keys_measure (shell, "\n", PROMPT_END);
+			keys_reset (shell);
+			j = 0;
+		}
+	}
+	bench_report ("keys insert", "us", samples, n_keys);
+	bench_report ("keys enter", "us", line_samples, n_lines);
+	free (line_samples);
+	free (samples);
+}
+
+/**
+ * Recalls the previous command lines with the up arrow.
+ **/
+static void
+keys_recall (keys_shell_t *shell)
+{
+	size_t n = n_keys;
+	if (n > n_history)
+	{
+		n = n_history;
+	}
+	if (n > READLINE_HISTORY_SIZE)
+	{
+		n = READLINE_HISTORY_SIZE;
+	}
+
+	// Readline only redraws the end of the line from the first character which
+	// differs from the previous line.
+	double *samples = malloc (sizeof (double) * n);
+	char previous[64] = "";
+	char line[64];
+	for (size_t i = 0; i < n; ++i)
+	{
+		size_t id = n_history - 1 - i;
+		snprintf (line, sizeof (line), KEYS_HISTORY_LINE, id % 97, id);
+		size_t j = 0;
+		while (line[j] == previous[j])
+		{
+			++j;
+		}
+		samples[i] = keys_measure (shell, "\033[A", line + j);
+		strcpy (previous, line);
+	}
+	keys_reset (shell);
+	bench_report ("keys history up", "us", samples, n);
+	free (samples);
+}
+
+/**
+ * Searches the history with Ctrl-R, measuring each character of the patterns.
+ * The first search also builds the index of the history.
+ **/
+static void
+keys_search (keys_shell_t *shell)
+{
+	double *samples = malloc (sizeof (double) * n_keys);
+	char pattern[32];
+	char keys[2] = { '\0', '\0' };
+	char expected[8];
+	srand (42);
+	for (size_t i = 0; i < n_keys;)
+	{
+		keys[0] = CTRL ('R');
+		keys_send (shell, keys);
+		keys_wait (shell, "`': ");
+
+		snprintf (pattern, sizeof (pattern), "target-%06zu",
+			(size_t) rand () % n_history);
+		for (size_t j = 0; pattern[j] && i < n_keys; ++j, ++i)
+		{
+			keys[0] = pattern[j];
+			// Readline only redraws the end of the prompt.
+			snprintf (expected, sizeof (expected), "%c': ", pattern[j]);
+			samples[i] = keys_measure (shell, keys, expected);
+		}
+		keys_reset (shell);
+	}
+	bench_report ("keys history search", "us", samples, n_keys);
+	free (samples);
+}
+
+/**
+ * Completes file names with Tab among the files of the current directory: an
+ * ambiguous name, which only rings the bell, then a unique one.
+ **/
+static void
+keys_complete (keys_shell_t *shell)
+{
+	size_t n = (n_keys + 1) / 2;
+	double *ambiguous = malloc (sizeof (double) * n);
+	double *unique = malloc (sizeof (double) * n);
+	char line[64];
+	srand (42);
+	for (size_t i = 0; i < n; ++i)
+	{
+		// Ten files start with this name.
+		size_t id = (size_t) rand () % (n_files / 10);
+		snprintf (line, sizeof (line), "true completion-%04zu", id);
+		keys_send (shell, line);
+		keys_wait (shell, line + 5);
+		ambiguous[i] = keys_measure (shell, "\t", "\007");
+
+		keys_send (shell, "3.");
+		keys_wait (shell, "3.");
+		unique[i] = keys_measure (shell, "\t", "txt ");
+		keys_reset (shell);
+	}
+	bench_report ("keys complete ambiguous", "us", ambiguous, n);
+	bench_report ("keys complete unique", "us", unique, n);
+	free (unique);
+	free (ambiguous);
+}
+
+/**
+ * Removes the temporary directory, also when the benchmark fails.
+ **/
+static void
+keys_remove_directory (void)
+{
+	nftw (directory, keys_remove, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static int
+keys_remove (const char *path, const struct stat *st, int flag,
+	struct FTW *ftw)
+{
+	remove (path);
+	return 0;
+}
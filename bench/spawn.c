@@ -0,0 +1,453 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+// Needed for openpty ().
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+/**
+ * How long the shell may take to run a command before the benchmark fails, in
+ * milliseconds.
+ **/
+#define TIMEOUT 10000
+
+/**
+ * The number of commands run before the measures.
+ **/
+#define WARMUP 100
+
+/**
+ * The number of times the shell is started to measure its startup.
+ **/
+#define STARTUP_RUNS 200
+
+/**
+ * The most time the shell may spend in its own code before it is ready to run
+ * a command line (as reported by its --profile-startup option), in
+ * milliseconds. It is about 0.05 ms: most of the startup is the dynamic
+ * loading of readline, which a budget would not catch reliably.
+ **/
+#define STARTUP_BUDGET 0.5
+
+/**
+ * The command lines run by default.
+ **/
+static const char *const default_commands[] = {
+	"/bin/true",
+	"true",
+	"/bin/true 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20",
+	"true | true"
+};
+
+#define N_DEFAULT_COMMANDS (sizeof (default_commands) / sizeof (*default_commands))
+
+/**
+ * A shell run by the benchmark. Its standard input is a pipe, so that it uses
+ * its non-interactive path, and its output is a terminal, so that it is
+ * flushed at the end of each line.
+ **/
+typedef struct
+{
+	pid_t pid;
+
+	/**
+	 * The write end of the standard input of the shell.
+	 **/
+	int input;
+
+	/**
+	 * The master side of the terminal of the shell.
+	 **/
+	int output;
+} spawn_shell_t;
+
+/**
+ * What the shell prints after each command: the output of "pwd".
+ **/
+static char *marker = NULL;
+
+static void
+spawn_start_shell (spawn_shell_t *shell, const char *path);
+
+static void
+spawn_stop_shell (spawn_shell_t *shell);
+
+static void
+spawn_write (const spawn_shell_t *shell, const char *chars, size_t length);
+
+static void
+spawn_wait_marker (const spawn_shell_t *shell);
+
+static long
+spawn_get_rss (pid_t pid);
+
+static void
+spawn_run (const char *shell_path, const char *command, size_t n);
+
+static bool
+spawn_check_startup (const char *shell_path, double budget);
+
+int
+main (int argc, char **argv)
+{
+	const char *shell_path = "bin/shelldon";
+	size_t n = 2000;
+	double budget = STARTUP_BUDGET;
+	int opt;
+	while (-1 != (opt = getopt (argc, argv, "b:n:s:")))
+	{
+		if ('b' == opt)
+		{
+			budget = atof (optarg);
+		}
+		else if ('n' == opt)
+		{
+			n = (size_t) atol (optarg);
+		}
+		else if ('s' == opt)
+		{
+			shell_path = optarg;
+		}
+		else
+		{
+			fprintf (stderr, "Usage: %s [-b STARTUP_MS] [-n COMMANDS] [-s SHELL]"
+				" [COMMAND_LINE...]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (!n)
+	{
+		n = 1;
+	}
+
+	char *cwd = getcwd (NULL, 0);
+	if (!cwd)
+	{
+		perror ("getcwd");
+		return EXIT_FAILURE;
+	}
+	marker = malloc (strlen (cwd) + 3);
+	strcpy (stpcpy (marker, cwd), "\r\n");
+	free (cwd);
+
+	signal (SIGPIPE, SIG_IGN);
+	fprintf (stderr, "%-32s %12s %12s %12s %12s\n", "benchmark", "median", "p99",
+		"min", "mean");
+	bool within_budget = spawn_check_startup (shell_path, budget);
+	if (optind < argc)
+	{
+		for (int i = optind; i < argc; ++i)
+		{
+			spawn_run (shell_path, argv[i], n);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < N_DEFAULT_COMMANDS; ++i)
+		{
+			spawn_run (shell_path, default_commands[i], n);
+		}
+	}
+	free (marker);
+
+	return (within_budget ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+/**
+ * Starts the shell STARTUP_RUNS times with an empty command line to measure
+ * its startup, until it exits, and the part spent in its own code, and
+ * returns false if the median of the latter exceeds "budget" milliseconds.
+ **/
+static bool
+spawn_check_startup (const char *shell_path, double budget)
+{
+	double samples[STARTUP_RUNS];
+	double own_samples[STARTUP_RUNS];
+	for (size_t i = 0; i < STARTUP_RUNS; ++i)
+	{
+		int report[2];
+		if (-1 == pipe (report))
+		{
+			perror ("Unable to create the shell's error output");
+			exit (EXIT_FAILURE);
+		}
+
+		uint64_t start = bench_now ();
+		pid_t pid = fork ();
+		if (-1 == pid)
+		{
+			perror ("fork");
+			exit (EXIT_FAILURE);
+		}
+		if (0 == pid)
+		{
+			int null = open ("/dev/null", O_RDWR);
+			dup2 (null, STDIN_FILENO);
+			dup2 (null, STDOUT_FILENO);
+			dup2 (report[1], STDERR_FILENO);
+			close (null);
+			close (report[0]);
+			close (report[1]);
+			execl (shell_path, shell_path, "--profile-startup", "-c", "",
+				(char *) NULL);
+			perror (shell_path);
+			_exit (EXIT_FAILURE);
+		}
+		close (report[1]);
+
+		char buffer[4096];
+		size_t length = 0;
+		ssize_t n;
+		while (length < sizeof (buffer) - 1
+			&& (n = read (report[0], buffer + length,
+				sizeof (buffer) - 1 - length)) > 0)
+		{
+			length += (size_t) n;
+		}
+		buffer[length] = '\0';
+		close (report[0]);
+		waitpid (pid, NULL, 0);
+		samples[i] = (double) (bench_now () - start) / 1e6;
+
+		const char *line = strstr (buffer, "Startup: ");
+		if (!line || 1 != sscanf (line, "Startup: %lf ms", own_samples + i))
+		{
+			fprintf (stderr, "The shell does not report its startup.\n");
+			exit (EXIT_FAILURE);
+		}
+		own_samples[i] *= 1000;
+	}
+
+	bench_report ("spawn startup", "ms", samples, STARTUP_RUNS);
+	bench_report ("spawn startup (own code)", "us", own_samples, STARTUP_RUNS);
+
+	double median = bench_get_percentile (own_samples, STARTUP_RUNS, 50) / 1000;
+	if (median > budget)
+	{
+		fprintf (stderr, "The startup exceeds its budget of %.3f ms.\n", budget);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Runs "command" "n" times in a new shell, one by one to measure the latency
+ * of each one, then "n" times at once to measure the throughput.
+ **/
+static void
+spawn_run (const char *shell_path, const char *command, size_t n)
+{
+	spawn_shell_t shell;
+	spawn_start_shell (&shell, shell_path);
+
+	// A command followed by "pwd", whose output tells that it is done.
+	size_t command_length = strlen (command);
+	char *line = malloc (command_length + 5);
+	memcpy (line, command, command_length);
+	memcpy (line + command_length, "\npwd\n", 5);
+	size_t line_length = command_length + 5;
+
+	for (size_t i = 0; i < WARMUP; ++i)
+	{
+		spawn_write (&shell, line, line_length);
+		spawn_wait_marker (&shell);
+	}
+	long rss = spawn_get_rss (shell.pid);
+
+	double *samples = malloc (sizeof (double) * n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		uint64_t start = bench_now ();
+		spawn_write (&shell, line, line_length);
+		spawn_wait_marker (&shell);
+		samples[i] = (double) (bench_now () - start) / 1000;
+	}
+
+	// The command lines are read by blocks.
+	size_t batch_length = n * (command_length + 1) + 4;
+	char *batch = malloc (batch_length);
+	char *p = batch;
+	for (size_t i = 0; i < n; ++i)
+	{
+		memcpy (p, command, command_length);
+		p[command_length] = '\n';
+		p += command_length + 1;
+	}
+	memcpy (p, "pwd\n", 4);
+
+	uint64_t start = bench_now ();
+	spawn_write (&shell, batch, batch_length);
+	spawn_wait_marker (&shell);
+	double duration = (double) (bench_now () - start) / 1e9;
+
+	size_t name_length = strlen (command) + 32;
+	char *name = malloc (name_length);
+	snprintf (name, name_length, "spawn %s", command);
+	bench_report (name, "us", samples, n);
+	snprintf (name, name_length, "spawn %s throughput", command);
+	bench_report_value (name, "commands/s", n / duration);
+	snprintf (name, name_length, "spawn %s rss growth", command);
+	bench_report_value (name, "KiB", (double) (spawn_get_rss (shell.pid) - rss));
+
+	free (name);
+	free (batch);
+	free (samples);
+	free (line);
+	spawn_stop_shell (&shell);
+}
+
+static void
+spawn_start_shell (spawn_shell_t *shell, const char *path)
+{
+	int input[2];
+	int master;
+	int slave;
+	if (-1 == pipe (input) || -1 == openpty (&master, &slave, NULL, NULL, NULL))
+	{
+		perror ("Unable to create the shell's input and output");
+		exit (EXIT_FAILURE);
+	}
+
+	shell->pid = fork ();
+	if (-1 == shell->pid)
+	{
+		perror ("fork");
+		exit (EXIT_FAILURE);
+	}
+	if (0 == shell->pid)
+	{
+		dup2 (input[0], STDIN_FILENO);
+		dup2 (slave, STDOUT_FILENO);
+		dup2 (slave, STDERR_FILENO);
+		close (input[0]);
+		close (input[1]);
+		close (master);
+		close (slave);
+		execl (path, path, (char *) NULL);
+		perror (path);
+		_exit (EXIT_FAILURE);
+	}
+
+	close (input[0]);
+	close (slave);
+	shell->input = input[1];
+	shell->output = master;
+}
+
+static void
+spawn_stop_shell (spawn_shell_t *shell)
+{
+	close (shell->input);
+	waitpid (shell->pid, NULL, 0);
+	close (shell->output);
+}
+
+static void
+spawn_write (const spawn_shell_t *shell, const char *chars, size_t length)
+{
+	while (length)
+	{
+		ssize_t n = write (shell->input, chars, length);
+		if (-1 == n)
+		{
+			if (EINTR == errno)
+			{
+				continue;
+			}
+			perror ("Unable to write to the shell");
+			exit (EXIT_FAILURE);
+		}
+		chars += n;
+		length -= (size_t) n;
+	}
+}
+
+/**
+ * Reads the output of the shell until it ends with the marker.
+ **/
+static void
+spawn_wait_marker (const spawn_shell_t *shell)
+{
+	char buffer[4096];
+	size_t length = 0;
+	size_t marker_length = strlen (marker);
+	while (length < marker_length
+		|| memcmp (buffer + length - marker_length, marker, marker_length))
+	{
+		struct pollfd fds = { shell->output, POLLIN, 0 };
+		if (poll (&fds, 1, TIMEOUT) <= 0)
+		{
+			fprintf (stderr, "The shell does not answer.\n");
+			exit (EXIT_FAILURE);
+		}
+
+		// Only the end of the output is kept.
+		if (length > sizeof (buffer) / 2)
+		{
+			memmove (buffer, buffer + length - marker_length, marker_length);
+			length = marker_length;
+		}
+		ssize_t n = read (shell->output, buffer + length,
+			sizeof (buffer) - length);
+		if (n <= 0)
+		{
+			fprintf (stderr, "The shell has stopped.\n");
+			exit (EXIT_FAILURE);
+		}
+		length += (size_t) n;
+	}
+}
+
+/**
+ * Returns the resident set size of a process in KiB, or -1.
+ **/
+static long
+spawn_get_rss (pid_t pid)
+{
+	char path[64];
+	snprintf (path, sizeof (path), "/proc/%d/status", (int) pid);
+	FILE *stream = fopen (path, "r");
+	if (!stream)
+	{
+		return -1;
+	}
+
+	long rss = -1;
+	char line[256];
+	while (-1 == rss && fgets (line, sizeof (line), stream))
+	{
+		sscanf (line, "VmRSS: %ld", &rss);
+	}
+	fclose (stream);
+
+	return rss;
+}
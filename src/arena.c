@@ -0,0 +1,201 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "arena.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "debug.h"
+#include "object.h"
+
+/**
+ * The alignment of the allocations.
+ */
+#define ALIGNMENT (sizeof (void *))
+
+struct arena_chunk_t {
+	/**
+	 * The previous (smaller) chunk.
+	 */
+	arena_chunk_t *next;
+
+	/**
+	 * The number of usable bytes after this header.
+	 */
+	size_t size;
+};
+
+static void
+arena_add_chunk (Arena *self, size_t size);
+
+static void
+arena_real_finalize (void *);
+
+static void
+arena_class_real_finalize (void *);
+
+static ArenaClass *klass = NULL;
+
+ArenaClass *
+arena_class_allocate (size_t size, void *parent, char *name)
+{
+	assert (name);
+	assert_cmpuint (size, >=, sizeof (ArenaClass));
+
+	ArenaClass *arena_class = ARENA_CLASS (object_class_allocate (size, parent, name));
+	if (!arena_class) // Allocation failed
+	{
+		return NULL;
+	}
+
+	OBJECT_CLASS (arena_class)->finalize = arena_real_finalize;
+
+	return arena_class;
+}
+
+ArenaClass *
+arena_class_get (void)
+{
+	if (!klass) // The Arena class is not yet initalized.
+	{
+		klass = arena_class_allocate (sizeof (ArenaClass), object_class_get (), "Arena");
+		OBJECT_CLASS (klass)->finalize_class = arena_class_real_finalize;
+		return klass;
+	}
+
+	return object_class_ref (klass);
+}
+
+Arena *
+arena_construct (size_t size, void *klass, size_t chunk_size)
+{
+	assert_cmpuint (size, >=, sizeof (Arena));
+
+	Arena *self = ARENA (object_construct (size, klass));
+
+	self->chunks = NULL;
+	self->pointer = NULL;
+	self->end = NULL;
+
+	arena_add_chunk (self, chunk_size);
+
+	return self;
+}
+
+void *
+arena_alloc (void *self, size_t size)
+{
+	assert (self);
+
+	// Rounds up to keep the next allocation aligned.
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	if ((size_t) (ARENA (self)->end - ARENA (self)->pointer) < size)
+	{
+		size_t chunk_size = ARENA (self)->chunks->size << 1;
+		arena_add_chunk (self, (chunk_size < size ? size : chunk_size));
+	}
+
+	void *p = ARENA (self)->pointer;
+	ARENA (self)->pointer += size;
+
+	return p;
+}
+
+bool
+arena_is_empty (const void *self)
+{
+	assert (self);
+
+	return (ARENA (self)->pointer == (char *) (ARENA (self)->chunks + 1));
+}
+
+void
+arena_reset (void *self)
+{
+	assert (self);
+
+	arena_chunk_t *chunk = ARENA (self)->chunks;
+	while (chunk->next)
+	{
+		arena_chunk_t *next = chunk->next->next;
+		free (chunk->next);
+		chunk->next = next;
+	}
+
+	ARENA (self)->pointer = (char *) (chunk + 1);
+}
+
+char *
+arena_strndup (void *self, const char *chars, size_t n)
+{
+	assert (chars);
+
+	char *copy = arena_alloc (self, n + 1);
+	memcpy (copy, chars, n);
+	copy[n] = '\0';
+
+	return copy;
+}
+
+/**
+ * Makes a new chunk of "size" usable bytes the current one.
+ */
+static void
+arena_add_chunk (Arena *self, size_t size)
+{
+	size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+	arena_chunk_t *chunk = malloc (sizeof (arena_chunk_t) + size);
+	assert (chunk);
+
+	chunk->next = self->chunks;
+	chunk->size = size;
+
+	self->chunks = chunk;
+	self->pointer = (char *) (chunk + 1);
+	self->end = self->pointer + size;
+
+	debug ("New Arena chunk: %zu", size);
+}
+
+static void
+arena_real_finalize (void *self)
+{
+	assert (self);
+
+	arena_chunk_t *chunk = ARENA (self)->chunks;
+	while (chunk)
+	{
+		arena_chunk_t *next = chunk->next;
+		free (chunk);
+		chunk = next;
+	}
+
+	assert (klass);
+	object_class_get_parent (klass)->finalize (self);
+}
+
+static void
+arena_class_real_finalize (void *_klass)
+{
+	assert (_klass == klass);
+	klass = NULL;
+}
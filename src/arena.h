@@ -0,0 +1,176 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "assert.h"
+#include "object.h"
+
+typedef struct Arena Arena;
+typedef struct ArenaClass ArenaClass;
+
+#define ARENA(pointer) ((Arena *) pointer)
+
+#define ARENA_CLASS(pointer) ((ArenaClass *) pointer)
+
+/**
+ * Represents the Arena class or an Arena-based class.
+ */
+struct ArenaClass {
+	ObjectClass parent;
+};
+
+/**
+ * Allocates and initializes a new Arena-based class of size "size" with name
+ * "name".
+ *
+ * This function is only useful to create an Arena-based class.
+ *
+ * @param size   The size of the structure of the class to allocate (must be
+ *               greater or equal to "sizeof (ArenaClass)".
+ * @param parent An owned reference to the parent class.
+ * @param name   The name of the class (must not be NULL).
+ *
+ * @return The new allocated memory with all fields filled.
+ */
+ArenaClass *
+arena_class_allocate (size_t size, void *parent, char *name);
+
+/**
+ * Returns an owned reference the Arena class.
+ *
+ * When no longer needed, the reference should be unreferenced by calling
+ * "object_class_unref (void *)".
+ *
+ * This function is only useful to create an Arena-based class.
+ *
+ * @return The reference.
+ */
+ArenaClass *
+arena_class_get (void);
+
+typedef struct arena_chunk_t arena_chunk_t;
+
+/**
+ * Represents an instance of the Arena type.
+ *
+ * An Arena is a bump allocator: memory is taken from large chunks and is only
+ * released all at once by arena_reset ().
+ */
+struct Arena {
+	Object parent;
+
+	/**
+	 * The chunks, the current (and biggest) one first.
+	 */
+	arena_chunk_t *chunks;
+
+	/**
+	 * The next free byte of the current chunk.
+	 */
+	char *pointer;
+
+	/**
+	 * The end of the current chunk.
+	 */
+	char *end;
+};
+
+/**
+ * Allocates a memory space of size "size" and initializes the Arena object.
+ *
+ * @param size       The memory space to allocate (greater or equal to
+ *                   "sizeof (Arena)").
+ * @param klass      An owned reference to the class of this object (must not
+ *                   be NULL).
+ * @param chunk_size The size of the first chunk.
+ *
+ * @return An owned reference to the newly allocated Arena.
+ */
+Arena *
+arena_construct (size_t size, void *klass, size_t chunk_size);
+
+/**
+ * Allocates and initializes a new Arena object.
+ *
+ * @param chunk_size The size of the first chunk.
+ *
+ * @return An owned reference to the newly allocated Arena or NULL if there was
+ *         an error.
+ */
+static inline Arena *
+arena_new (size_t chunk_size);
+
+/**
+ * Allocates "size" bytes (aligned for any pointer) in the Arena.
+ *
+ * @param self The Arena.
+ * @param size The number of bytes.
+ *
+ * @return The memory, valid until the next arena_reset ().
+ */
+void *
+arena_alloc (void *self, size_t size);
+
+/**
+ * Returns whether nothing has been allocated in the Arena since it was
+ * constructed or reset.
+ *
+ * @param self The Arena.
+ *
+ * @return True if the Arena is empty.
+ */
+bool
+arena_is_empty (const void *self);
+
+/**
+ * Releases everything which has been allocated in the Arena.
+ *
+ * Only the biggest chunk is kept, so once it is large enough, this is done in
+ * constant time without any call to free ().
+ *
+ * @param self The Arena.
+ */
+void
+arena_reset (void *self);
+
+/**
+ * Copies the "n" first characters of "chars" in the Arena and adds a trailing
+ * '\0'.
+ *
+ * @param self  The Arena.
+ * @param chars The characters to copy (must not be NULL).
+ * @param n     The number of characters to copy.
+ *
+ * @return The copy, valid until the next arena_reset ().
+ */
+char *
+arena_strndup (void *self, const char *chars, size_t n);
+
+// Inline functions:
+
+static inline Arena *
+arena_new (size_t chunk_size)
+{
+	return arena_construct (sizeof (Arena), arena_class_get (), chunk_size);
+}
+
+#endif
@@ -186,7 +186,7 @@ array_remove_at (void *self, size_t index)
 	}
 
 	void **p = ARRAY (self)->array + index;
-	memmove (p, p + 1, sizeof (void *) * (size - index));
+	memmove (p, p + 1, sizeof (void *) * (size - index - 1));
 
 	--(ARRAY (self)->size);
 }
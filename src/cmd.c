@@ -17,6 +17,9 @@
 
 #include <error.h>
 #include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -24,12 +27,240 @@
 
 #include "array.h"
 #include "cmd.h"
+#include "histogram.h"
+#include "history_index.h"
+#include "history_store.h"
+#include "object.h"
+#include "path_cache.h"
+#include "pipeline.h"
+#include "profile.h"
 #include "shell.h"
+#include "string.h"
 #include "tools.h"
+#include "usage.h"
 #include "version.h"
 
 extern char **environ;
 
+/**
+ * Returns the path of the program "name" using the shell's cache, or prints an
+ * error and returns NULL if it cannot be found.
+ */
+static const char *
+resolve_program (Shell *shell, const char *name)
+{
+	uint64_t start = profile_now ();
+	const char *path = path_cache_lookup (shell_get_path_cache (shell), name);
+	profile_add (PROFILE_PATH_LOOKUP, start);
+	if (!path)
+	{
+		fprintf (stderr, "%s: command not found.\n", name);
+	}
+	return path;
+}
+
+/**
+ * Executes the program, or the pipeline if "args" contains NULL items, and
+ * returns its pid (or its process group for a pipeline), or -1 if it could not
+ * be started.
+ *
+ * Programs started in background, or in foreground by an interactive shell,
+ * are always run as pipelines (possibly of one stage) to have their own
+ * process group and are registered as jobs, so that they can be stopped from
+ * the terminal.
+ */
+static pid_t
+run_program (Shell *shell, void *args, exec_mode mode, int *status)
+{
+	size_t n = 1;
+	for (size_t i = 0, size = array_get_size (args); i < size; ++i)
+	{
+		if (!array_get (args, i))
+		{
+			++n;
+		}
+	}
+
+	if (1 == n && EXEC_FG == mode && !shell_is_interactive (shell)) // No job.
+	{
+		const char *path = resolve_program (shell, array_get (args, 0));
+		if (!path)
+		{
+			return -1;
+		}
+
+		pid_t pid = execute (path, args, mode, status);
+		if (-1 == pid)
+		{
+			error (0, errno, "%s", path);
+		}
+		return pid;
+	}
+
+	// The arguments of each stage are slices of this vector.
+	char **argv = (char **) array_get_array (args, true);
+	char ***argvs = malloc (sizeof (char **) * n);
+	char **files = calloc (n, sizeof (char *));
+	assert (argv && argvs && files);
+
+	bool valid = true;
+	for (size_t i = 0, j = 0; valid && i < n; ++i)
+	{
+		argvs[i] = argv + j;
+		if (!argv[j])
+		{
+			fprintf (stderr, "Syntax error: empty command in the pipeline.\n");
+			valid = false;
+		}
+		else
+		{
+			// Paths returned by the cache may be invalidated by the next lookups.
+			const char *path = resolve_program (shell, argv[j]);
+			if (path)
+			{
+				files[i] = strdup (path);
+			}
+			else
+			{
+				valid = false;
+			}
+
+			while (argv[j])
+			{
+				++j;
+			}
+			++j; // Skips the separator.
+		}
+	}
+
+	pid_t pid = -1;
+	if (valid)
+	{
+		pid_t *pids = malloc (sizeof (pid_t) * n);
+		assert (pids);
+
+		pid = execute_pipeline (n, (const char *const *) files,
+			(char *const *const *) argvs, mode, pids);
+		if (-1 == pid)
+		{
+			error (0, errno, "Failed to start the pipeline");
+		}
+		else
+		{
+			// A pipeline in foreground is a job too, so that it can be stopped.
+			String *command = string_new ();
+			for (size_t i = 0, size = array_get_size (args); i < size; ++i)
+			{
+				if (i)
+				{
+					string_append_char (command, ' ');
+				}
+				const char *arg = array_get (args, i);
+				string_append (command, (arg ? arg : "|"));
+			}
+
+			job_t *job = shell_add_job (shell, pid, pids, n,
+				string_get_chars (command));
+			object_unref (command);
+
+			if (EXEC_FG == mode)
+			{
+				uint64_t start = profile_now ();
+				int job_status = shell_wait_job (shell, job, true);
+				profile_add (PROFILE_WAIT, start);
+				if (status)
+				{
+					*status = job_status;
+				}
+			}
+			else if (shell_is_interactive (shell))
+			{
+				fprintf (stderr, "[%u] %d\n", job->id, (int) pid);
+			}
+		}
+		free (pids);
+	}
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		free (files[i]);
+	}
+	free (files);
+	free (argvs);
+	free (argv);
+
+	return pid;
+}
+
+/**
+ * Returns the job designated by the first argument ("N" or "%N"), or the most
+ * recent one if there is none, or prints an error and returns NULL.
+ */
+static job_t *
+get_job_argument (Shell *shell, void *args)
+{
+	unsigned int id = 0;
+	if (!array_is_empty (args))
+	{
+		const char *arg = array_get (args, 0);
+		if ('%' == *arg)
+		{
+			++arg;
+		}
+
+		char *end;
+		id = (unsigned int) strtoul (arg, &end, 10);
+		if (!id || *end)
+		{
+			fprintf (stderr, "Invalid job \"%s\".\n", (char *) array_get (args, 0));
+			return NULL;
+		}
+	}
+
+	job_t *job = shell_get_job (shell, id);
+	if (!job)
+	{
+		fprintf (stderr, "No such job.\n");
+	}
+	return job;
+}
+
+/**
+ * Sorts the command stats by decreasing total duration.
+ */
+static int
+compare_command_stats (const void *a, const void *b)
+{
+	uint64_t total_a = histogram_get_total ((*(command_stat_t * const *) a)->histogram);
+	uint64_t total_b = histogram_get_total ((*(command_stat_t * const *) b)->histogram);
+	return (total_a < total_b) - (total_a > total_b);
+}
+
+static void
+print_path_cache_entry (const path_cache_entry_t *entry, void *data)
+{
+	if (entry->path)
+	{
+		printf ("%4u\t%s\n", entry->hits, entry->path);
+	}
+	else
+	{
+		printf ("%4u\t%s (not found)\n", entry->hits, entry->name);
+	}
+}
+
+static void
+print_class_reuse (const ObjectClass *klass, void *data)
+{
+	unsigned long n_constructed = object_class_get_n_constructed (klass);
+	if (n_constructed)
+	{
+		unsigned long n_reused = object_class_get_n_reused (klass);
+		printf ("%-24s %12lu %12lu %7.1f%%\n", object_class_get_name (klass),
+			n_constructed, n_reused, 100.0 * n_reused / n_constructed);
+	}
+}
+
 int
 cmd_cd (Shell *shell, void *args)
 {
@@ -95,6 +326,74 @@ cmd_cd (Shell *shell, void *args)
 	return 0;
 }
 
+int
+cmd_fg (Shell *shell, void *args)
+{
+	shell_update_jobs (shell);
+
+	job_t *job = get_job_argument (shell, args);
+	if (!job)
+	{
+		return -1;
+	}
+
+	printf ("%s\n", job->command);
+	fflush (stdout);
+
+	if (JOB_STOPPED == job->state)
+	{
+		kill (-job->pgid, SIGCONT);
+		job->state = JOB_RUNNING;
+	}
+
+	return shell_wait_job (shell, job, true);
+}
+
+int
+cmd_hash (Shell *shell, void *args)
+{
+	PathCache *cache = shell_get_path_cache (shell);
+
+	if (array_is_empty (args))
+	{
+		if (!path_cache_get_size (cache))
+		{
+			printf ("hash: hash table empty\n");
+			return 0;
+		}
+		printf ("hits\tcommand\n");
+		path_cache_foreach (cache, print_path_cache_entry, NULL);
+		return 0;
+	}
+
+	const char *opt = array_get (args, 0);
+	if (0 == strcmp ("-r", opt))
+	{
+		path_cache_clear (cache);
+		return 0;
+	}
+	if (0 == strcmp ("-p", opt))
+	{
+		if (array_get_size (args) != 3)
+		{
+			fprintf (stderr, "The command hash -p expects two arguments.\n");
+			return -1;
+		}
+		path_cache_set (cache, array_get (args, 2), array_get (args, 1));
+		return 0;
+	}
+
+	int return_value = 0;
+	for (size_t i = 0, n = array_get_size (args); i < n; ++i)
+	{
+		if (!resolve_program (shell, array_get (args, i)))
+		{
+			return_value = -1;
+		}
+	}
+	return return_value;
+}
+
 int
 cmd_history (Shell *shell, void *args)
 {
@@ -106,12 +405,87 @@ cmd_history (Shell *shell, void *args)
 	const char *opt = array_get (args, 0);
 	if (0 == strcmp ("-c", opt))
 	{
-		clear_history ();
+		shell_clear_history (shell);
+		return 0;
+	}
+	if (0 == strcmp ("-s", opt))
+	{
+		if (array_get_size (args) != 2)
+		{
+			fprintf (stderr, "The option -s expects a pattern.\n");
+			return -1;
+		}
+
+		// The matches are found from the most recent one but printed in order.
+		HistoryIndex *index = shell_get_history_index (shell);
+		const char *pattern = array_get (args, 1);
+		Array *matches = array_new (NULL);
+		for (size_t id = history_index_search (index, pattern,
+				history_index_get_size (index));
+			HISTORY_INDEX_NONE != id;
+			id = history_index_search (index, pattern, id))
+		{
+			array_append (matches, (void *) history_index_get (index, id));
+		}
+		for (size_t i = array_get_size (matches); i > 0; --i)
+		{
+			puts (array_get (matches, i - 1));
+		}
+		object_unref (matches);
+
+		return 0;
+	}
+	if (0 == strcmp ("-r", opt) || 0 == strcmp ("-w", opt))
+	{
+		if (array_get_size (args) != 2)
+		{
+			fprintf (stderr, "The option %s expects a file.\n", opt);
+			return -1;
+		}
+
+		const char *file = array_get (args, 1);
+		int result;
+		if ('r' == opt[1])
+		{
+			result = shell_import_history (shell, file);
+		}
+		else
+		{
+			HistoryStore *store = shell_get_history_store (shell);
+			result = (store ? history_store_export (store, file)
+				: write_history (file));
+		}
+		if (result)
+		{
+			error (0, (-1 == result ? errno : result), "%s", file);
+			return -1;
+		}
 		return 0;
 	}
 	return -1;
 }
 
+int
+cmd_bg (Shell *shell, void *args)
+{
+	shell_update_jobs (shell);
+
+	job_t *job = get_job_argument (shell, args);
+	if (!job)
+	{
+		return -1;
+	}
+
+	if (JOB_STOPPED == job->state)
+	{
+		kill (-job->pgid, SIGCONT);
+		job->state = JOB_RUNNING;
+	}
+	shell_print_job (shell, job);
+
+	return 0;
+}
+
 int
 cmd_exec (Shell *shell, void *args)
 {
@@ -121,7 +495,13 @@ cmd_exec (Shell *shell, void *args)
 		return -1;
 	}
 
-	execute (array_get (args, 0), args, EXEC_REPLACE, NULL);
+	const char *path = resolve_program (shell, array_get (args, 0));
+	if (!path)
+	{
+		return -1;
+	}
+
+	execute (path, args, EXEC_REPLACE, NULL);
 	error (0, errno, "Error");
 	return -1;
 }
@@ -135,7 +515,7 @@ cmd_execbg (Shell *shell, void *args)
 		return -1;
 	}
 
-	return execute (array_get (args, 0), args, EXEC_BG, NULL);
+	return run_program (shell, args, EXEC_BG, NULL);
 }
 
 int
@@ -148,9 +528,8 @@ cmd_execfg (Shell *shell, void *args)
 	}
 
 	int status;
-	if (-1 == execute (array_get (args, 0), args, EXEC_FG, &status))
+	if (-1 == run_program (shell, args, EXEC_FG, &status))
 	{
-		fprintf (stderr, "fork () failed.\n");
 		return -1;
 	}
 	return status;
@@ -212,6 +591,41 @@ cmd_help (Shell *shell, void *args)
 	return return_value;
 }
 
+int
+cmd_jobs (Shell *shell, void *args)
+{
+	shell_update_jobs (shell);
+
+	const Array *jobs = shell_get_jobs (shell);
+	for (size_t i = 0, n = array_get_size (jobs); i < n; ++i)
+	{
+		shell_print_job (shell, array_get (jobs, i));
+	}
+	return 0;
+}
+
+int
+cmd_profile (Shell *shell, void *args)
+{
+	if (array_is_empty (args))
+	{
+		profile_print (stdout);
+
+		// How often the instances reuse the memory of destroyed ones.
+		printf ("\n%-24s %12s %12s %8s\n", "class", "instances", "reused",
+			"rate");
+		object_class_foreach (print_class_reuse, NULL);
+		return 0;
+	}
+	if (1 == array_get_size (args) && 0 == strcmp ("-r", array_get (args, 0)))
+	{
+		profile_clear ();
+		return 0;
+	}
+	fprintf (stderr, "Usage: profile [-r]\n");
+	return -1;
+}
+
 int
 cmd_pwd (Shell *shell, void *args)
 {
@@ -249,6 +663,108 @@ cmd_setenv (Shell *shell, void *args)
 	return 0;
 }
 
+int
+cmd_stats (Shell *shell, void *args)
+{
+	if (1 == array_get_size (args))
+	{
+		const char *opt = array_get (args, 0);
+		int result = -2;
+		if (opt && 0 == strcmp ("-c", opt))
+		{
+			result = shell_reset_command_stats (shell);
+		}
+		else if (opt && 0 == strcmp ("-p", opt))
+		{
+			result = shell_save_command_stats (shell, true);
+		}
+		else if (opt && 0 == strcmp ("-P", opt))
+		{
+			result = shell_unsave_command_stats (shell);
+		}
+		if (-1 == result)
+		{
+			error (0, errno, "stats");
+		}
+		if (-2 != result)
+		{
+			return result;
+		}
+	}
+	if (!array_is_empty (args))
+	{
+		fprintf (stderr, "Usage: stats [-c | -p | -P]\n");
+		return -1;
+	}
+
+	Array *stats = shell_get_command_stats (shell);
+	size_t n = array_get_size (stats);
+	command_stat_t **sorted = (command_stat_t **) array_get_array (stats, false);
+	assert (!n || sorted);
+	qsort (sorted, n, sizeof (command_stat_t *), compare_command_stats);
+
+	printf ("%8s %10s %10s %10s %12s  %s\n", "COUNT", "P50 (ms)", "P99 (ms)",
+		"MAX (ms)", "TOTAL (ms)", "COMMAND");
+	for (size_t i = 0; i < n; ++i)
+	{
+		const Histogram *histogram = sorted[i]->histogram;
+		printf ("%8" PRIu64 " %10.3f %10.3f %10.3f %12.3f  %s\n",
+			histogram_get_count (histogram),
+			histogram_get_percentile (histogram, 50) / 1000.0,
+			histogram_get_percentile (histogram, 99) / 1000.0,
+			histogram_get_max (histogram) / 1000.0,
+			histogram_get_total (histogram) / 1000.0, sorted[i]->name);
+	}
+
+	free (sorted);
+	object_unref (stats);
+	return 0;
+}
+
+int
+cmd_time (Shell *shell, void *args)
+{
+	if (array_is_empty (args))
+	{
+		const usage_t *usage = shell_get_last_usage (shell);
+		if (usage->n_programs)
+		{
+			shell_print_usage (shell, usage);
+		}
+		return 0;
+	}
+
+	const char *arg = array_get (args, 0);
+	if (arg && 0 == strcmp ("-t", arg))
+	{
+		if (1 == array_get_size (args))
+		{
+			printf ("%ld\n", shell_get_report_time (shell));
+			return 0;
+		}
+
+		char *end;
+		long report_time = (array_get (args, 1)
+			? strtol (array_get (args, 1), &end, 10) : 0);
+		if (2 != array_get_size (args) || !array_get (args, 1) || *end)
+		{
+			fprintf (stderr, "Usage: time [-t MS | COMMAND...]\n");
+			return -1;
+		}
+		shell_set_report_time (shell, (report_time < 0 ? -1 : report_time));
+		return 0;
+	}
+
+	usage_t usage;
+	usage_begin (&usage);
+	int status = -1;
+	shell_execute_words (shell, args, &status);
+	usage_end (&usage);
+	shell_print_usage (shell, &usage);
+
+	return status;
+}
+
 int
 cmd_version (Shell *shell, void *args)
 {
@@ -270,6 +786,39 @@ cmd_version (Shell *shell, void *args)
 	return 0;
 }
 
+int
+cmd_wait (Shell *shell, void *args)
+{
+	shell_update_jobs (shell);
+
+	if (!array_is_empty (args))
+	{
+		job_t *job = get_job_argument (shell, args);
+		if (!job)
+		{
+			return -1;
+		}
+		return shell_wait_job (shell, job, false);
+	}
+
+	// Waits for all the jobs which are not stopped.
+	int status = 0;
+	const Array *jobs = shell_get_jobs (shell);
+	for (size_t i = 0; i < array_get_size (jobs);)
+	{
+		job_t *job = array_get (jobs, i);
+		if (JOB_STOPPED == job->state)
+		{
+			++i;
+		}
+		else
+		{
+			status = shell_wait_job (shell, job, false);
+		}
+	}
+	return status;
+}
+
 int
 cmd_sdc (Shell *s, void *args)
 {
@@ -20,6 +20,15 @@
 
 #include "shell.h"
 
+/**
+ * Resumes a stopped job in background.
+ *
+ * @param args An Array which contains the job number (optional).
+ * @return 0 if success, else -1.
+ **/
+int
+cmd_bg (Shell *shell, void *args);
+
 /**
  * Changes current directory.
  *
@@ -30,7 +39,33 @@ int
 cmd_cd (Shell *shell, void *args);
 
 /**
- * TODO: write help.
+ * Resumes a job in foreground and waits for it.
+ *
+ * @param args An Array which contains the job number (optional).
+ * @return The status of the job, or -1 if it failed or has been stopped.
+ **/
+int
+cmd_fg (Shell *shell, void *args);
+
+/**
+ * Manages the cache of programs locations.
+ *
+ * Without arguments, lists the cache. "-r" empties it, "-p PATH NAME" sets the
+ * location of NAME and any other argument is looked up and added to it.
+ *
+ * @param args An Array which contains the arguments.
+ * @return 0 if success, else -1.
+ **/
+int
+cmd_hash (Shell *shell, void *args);
+
+/**
+ * Manages the history: "-c" clears it, "-r FILE" adds the lines of the text
+ * file FILE to it, "-w FILE" writes it to FILE, one command line per line, and
+ * "-s PATTERN" prints the command lines containing PATTERN.
+ *
+ * @param args An Array which contains the arguments.
+ * @return 0 if success, else -1.
  **/
 int
 cmd_history (Shell *shell, void *args);
@@ -74,6 +109,25 @@ cmd_exit (Shell *shell, void *args);
 int
 cmd_help (Shell *shell, void *args);
 
+/**
+ * Lists the jobs.
+ *
+ * @param args An Array which contains the arguments (not used).
+ * @return 0.
+ **/
+int
+cmd_jobs (Shell *shell, void *args);
+
+/**
+ * Shows the durations measured for each phase of the shell (see profile.h), or
+ * forgets them if the argument is "-r".
+ *
+ * @param args An Array which contains the arguments.
+ * @return 0 if success, else -1.
+ **/
+int
+cmd_profile (Shell *shell, void *args);
+
 /**
  * Shows the current working directory.
  *
@@ -93,6 +147,30 @@ cmd_pwd (Shell *shell, void *args);
 int
 cmd_setenv (Shell *shell, void *args);
 
+/**
+ * Shows how many times each command has been executed and the percentiles of
+ * the durations of its command lines. With "-c", forgets them. With "-p",
+ * saves them in the configuration directory so that they are kept across
+ * sessions, and with "-P", removes them from it.
+ *
+ * @param args An Array which contains an option or nothing.
+ * @return 0 on success, -1 on error.
+ **/
+int
+cmd_stats (Shell *shell, void *args);
+
+/**
+ * Executes a command, which may be a pipeline, then shows the resources used
+ * by its programs (see usage.h). Without arguments, shows the ones of the last
+ * command line which has run programs. With "-t MS", sets the duration from
+ * which they are shown after each command line (-1 to never show them).
+ *
+ * @param args An Array which contains the command to execute.
+ * @return The status of the command, or -1 if it failed.
+ **/
+int
+cmd_time (Shell *shell, void *args);
+
 /**
  * Shows the version of Shelldon.
  *
@@ -102,6 +180,15 @@ cmd_setenv (Shell *shell, void *args);
 int
 cmd_version (Shell *shell, void *args);
 
+/**
+ * Waits for a job or, if none is specified, for all the running jobs.
+ *
+ * @param args An Array which contains the job number (optional).
+ * @return The status of the last job waited for, or -1 if it failed.
+ **/
+int
+cmd_wait (Shell *shell, void *args);
+
 int
 cmd_sdc (Shell *s, void *args);
 
@@ -0,0 +1,344 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "command_line.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#	include <emmintrin.h>
+#endif
+
+#include "arena.h"
+#include "array.h"
+#include "assert.h"
+#include "object.h"
+#include "string.h"
+
+static inline const char *
+command_line_find_special (const char *p, const char *end);
+
+/**
+ * The number of items first allocated for a CommandLine, enough for most
+ * command lines so that their items are allocated once.
+ */
+#define ITEMS_CAPACITY 32
+
+static inline void
+command_line_append (CommandLine *self, char *word);
+
+static void
+command_line_tokenize (CommandLine *self, char *line, size_t length);
+
+static void
+command_line_real_finalize (void *);
+
+static void
+command_line_class_real_finalize (void *);
+
+static CommandLineClass *klass = NULL;
+
+CommandLineClass *
+command_line_class_allocate (size_t size, void *parent, char *name)
+{
+	assert (name);
+	assert_cmpuint (size, >=, sizeof (CommandLineClass));
+
+	CommandLineClass *command_line_class = COMMAND_LINE_CLASS (array_class_allocate (size, parent, name));
+	if (!command_line_class) // Allocation failed
+	{
+		return NULL;
+	}
+
+	OBJECT_CLASS (command_line_class)->finalize = command_line_real_finalize;
+
+	return command_line_class;
+}
+
+CommandLineClass *
+command_line_class_get (void)
+{
+	if (!klass) // The CommandLine class is not yet initalized.
+	{
+		klass = command_line_class_allocate (sizeof (CommandLineClass), array_class_get (), "CommandLine");
+		OBJECT_CLASS (klass)->finalize_class = command_line_class_real_finalize;
+		return klass;
+	}
+
+	return object_class_ref (klass);
+}
+
+CommandLine *
+command_line_construct (size_t size, void *klass, const char *text,
+	Arena *arena)
+{
+	assert_cmpuint (size, >=, sizeof (CommandLine));
+	assert (text);
+	assert (!arena || arena_is_empty (arena));
+
+	CommandLine *self = COMMAND_LINE (array_construct (size, klass, NULL));
+
+	size_t length = strlen (text);
+	self->length = length;
+	self->hash = string_hash (text);
+	self->arena = (arena ? object_ref (arena) : NULL);
+
+	// The text is kept as is and followed by the copy which is tokenized.
+	self->buffer = (arena ? arena_alloc (arena, 2 * (length + 1))
+		: malloc (2 * (length + 1)));
+	assert (self->buffer);
+	memcpy (self->buffer, text, length + 1);
+	char *words = self->buffer + length + 1;
+	memcpy (words, text, length + 1);
+
+	// A line has at most one item per character.
+	if (!arena)
+	{
+		array_ensure_capacity (self, (length < ITEMS_CAPACITY ? length + 1
+			: ITEMS_CAPACITY));
+	}
+	command_line_tokenize (self, words, length);
+
+	self->pipeline = false;
+	for (size_t i = 0, n = array_get_size (self); i < n; ++i)
+	{
+		if (!array_get (self, i))
+		{
+			self->pipeline = true;
+			break;
+		}
+	}
+	self->arguments = NULL;
+
+	return self;
+}
+
+Array *
+command_line_get_arguments (void *self)
+{
+	assert (self);
+
+	if (!COMMAND_LINE (self)->arguments)
+	{
+		// The items are shared, they are detached before it is destroyed.
+		Array *arguments = array_new (NULL);
+		size_t size = array_get_size (self);
+		if (size > 1)
+		{
+			arguments->array = ARRAY (self)->array + 1;
+			arguments->size = arguments->capacity = size - 1;
+		}
+		COMMAND_LINE (self)->arguments = arguments;
+	}
+
+	return COMMAND_LINE (self)->arguments;
+}
+
+/**
+ * Returns the first character of [p, end[ which may have a special meaning for
+ * the tokenizer (' ', '|', quotes and '\\'), or "end" if there is none.
+ */
+static inline const char *
+command_line_find_special (const char *p, const char *end)
+{
+#ifdef __SSE2__
+	// Checks 16 characters at once.
+	const __m128i space = _mm_set1_epi8 (' ');
+	const __m128i pipe = _mm_set1_epi8 ('|');
+	const __m128i single_quote = _mm_set1_epi8 ('\'');
+	const __m128i double_quote = _mm_set1_epi8 ('"');
+	const __m128i backslash = _mm_set1_epi8 ('\\');
+	for (; end - p >= 16; p += 16)
+	{
+		__m128i chars = _mm_loadu_si128 ((const __m128i *) p);
+		__m128i found = _mm_or_si128 (
+			_mm_or_si128 (_mm_cmpeq_epi8 (chars, space),
+				_mm_cmpeq_epi8 (chars, pipe)),
+			_mm_or_si128 (
+				_mm_or_si128 (_mm_cmpeq_epi8 (chars, single_quote),
+					_mm_cmpeq_epi8 (chars, double_quote)),
+				_mm_cmpeq_epi8 (chars, backslash)));
+
+		int mask = _mm_movemask_epi8 (found);
+		if (mask)
+		{
+			return p + __builtin_ctz (mask);
+		}
+	}
+#endif
+
+	while (p < end && ' ' != *p && '|' != *p && '\'' != *p && '"' != *p
+		&& '\\' != *p)
+	{
+		++p;
+	}
+	return p;
+}
+
+/**
+ * Appends a word (or NULL) to the items, which are taken from the Arena if
+ * the CommandLine is built in one.
+ */
+static inline void
+command_line_append (CommandLine *self, char *word)
+{
+	Array *array = ARRAY (self);
+	if (self->arena && array->size == array->capacity)
+	{
+		// The previous block is only released with the Arena.
+		size_t capacity = (array->capacity ? 2 * array->capacity
+			: ITEMS_CAPACITY);
+		void **items = arena_alloc (self->arena, capacity * sizeof (void *));
+		if (array->size)
+		{
+			memcpy (items, array->array, array->size * sizeof (void *));
+		}
+		array->array = items;
+		array->capacity = capacity;
+	}
+
+	array_append (array, word);
+}
+
+/**
+ * Splits "line" into words appended to the CommandLine.
+ *
+ * The line is modified in place: the words are unescaped and '\0' terminated
+ * where they are, so they are slices of "line". Since unescaping only removes
+ * characters, a word never overlaps the characters which remain to be read.
+ */
+static void
+command_line_tokenize (CommandLine *self, char *line, size_t length)
+{
+	const char *r = line; // Reading position.
+	const char *end = line + length;
+	char *w = line; // Writing position.
+	char *word = NULL; // The start of the current word.
+
+	char current_delim = ' ';
+	while (r < end)
+	{
+		// Copies the ordinary characters at once.
+		const char *special = command_line_find_special (r, end);
+		if (special != r)
+		{
+			if (!word)
+			{
+				word = w;
+			}
+			if (w != r) // Something has been removed before.
+			{
+				memmove (w, r, (size_t) (special - r));
+			}
+			w += special - r;
+			r = special;
+
+			if (r == end)
+			{
+				break;
+			}
+		}
+
+		char c = *r++;
+		bool separator = false;
+		if ('\\' == c)
+		{
+			if (r == end) // A trailing backslash is ignored.
+			{
+				break;
+			}
+			c = *r++;
+		}
+		else if (' ' == c || '|' == c)
+		{
+			separator = (current_delim == ' ');
+		}
+		else if ( ('\'' == c && current_delim != '"')
+			|| ('"' == c && current_delim != '\'') )
+		{
+			current_delim = (current_delim == ' ' ? c : ' ');
+			separator = true;
+		}
+
+		if (!separator) // Literal character.
+		{
+			if (!word)
+			{
+				word = w;
+			}
+			*w++ = c;
+			continue;
+		}
+
+		if (word) // Ends the current word.
+		{
+			*w++ = '\0';
+			command_line_append (self, word);
+			word = NULL;
+		}
+		if ('|' == c)
+		{
+			command_line_append (self, NULL);
+		}
+	}
+
+	if (word)
+	{
+		*w = '\0';
+		command_line_append (self, word);
+	}
+}
+
+static void
+command_line_real_finalize (void *self)
+{
+	assert (self);
+
+	Array *arguments = COMMAND_LINE (self)->arguments;
+	if (arguments)
+	{
+		arguments->array = NULL;
+		arguments->size = arguments->capacity = 0;
+		object_unref (arguments);
+	}
+
+	Arena *arena = COMMAND_LINE (self)->arena;
+	if (arena)
+	{
+		// The items are not freed by the Array.
+		ARRAY (self)->array = NULL;
+		ARRAY (self)->size = ARRAY (self)->capacity = 0;
+
+		arena_reset (arena);
+		object_unref (arena);
+	}
+	else
+	{
+		free (COMMAND_LINE (self)->buffer);
+	}
+
+	assert (klass);
+	object_class_get_parent (klass)->finalize (self);
+}
+
+static void
+command_line_class_real_finalize (void *_klass)
+{
+	assert (_klass == klass);
+	klass = NULL;
+}
@@ -0,0 +1,235 @@
+/**
+ * This file is a part of Shelldon.
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "array.h"
+#include "assert.h"
+
+typedef struct CommandLine CommandLine;
+typedef struct CommandLineClass CommandLineClass;
+
+#define COMMAND_LINE(pointer) ((CommandLine *) pointer)
+
+#define COMMAND_LINE_CLASS(pointer) ((CommandLineClass *) pointer)
+
+/**
+ * Represents the CommandLine class or a CommandLine-based class.
+ */
+struct CommandLineClass {
+	ArrayClass parent;
+};
+
+/**
+ * Allocates and initializes a new CommandLine-based class of size "size" with
+ * name "name".
+ *
+ * This function is only useful to create a CommandLine-based class.
+ *
+ * @param size   The size of the structure of the class to allocate (must be
+ *               greater or equal to "sizeof (CommandLineClass)".
+ * @param parent An owned reference to the parent class.
+ * @param name   The name of the class (must not be NULL).
+ *
+ * @return The new allocated memory with all fields filled.
+ */
+CommandLineClass *
+command_line_class_allocate (size_t size, void *parent, char *name);
+
+/**
+ * Returns an owned reference the CommandLine class.
+ *
+ * When no longer needed, the reference should be unreferenced by calling
+ * "object_class_unref (void *)".
+ *
+ * This function is only useful to create a CommandLine-based class.
+ *
+ * @return The reference.
+ */
+CommandLineClass *
+command_line_class_get (void);
+
+/**
+ * Represents an instance of the CommandLine type.
+ *
+ * It is an Array containing the words of a parsed command line. The unquoted
+ * and unescaped '|' characters separate the commands of a pipeline, they are
+ * represented by NULL items.
+ *
+ * A CommandLine is immutable once constructed so that it can be shared: it
+ * must not be modified with the Array functions.
+ *
+ * It can be built in an Arena, which then holds its text, its words and its
+ * items instead of malloc (): the Arena is reset when the CommandLine is
+ * destroyed, so it must only hold one CommandLine at a time.
+ */
+struct CommandLine {
+	Array parent;
+
+	/**
+	 * A single memory block holding the text of the command line followed by
+	 * its words, which are slices of it.
+	 */
+	char *buffer;
+
+	/**
+	 * The length of the text of the command line.
+	 */
+	size_t length;
+
+	/**
+	 * The hash of the text of the command line (see string_hash ()).
+	 */
+	size_t hash;
+
+	/**
+	 * True if the command line contains several commands.
+	 */
+	bool pipeline;
+
+	/**
+	 * The words following the first one (a view on the items of the
+	 * CommandLine, which does not own them), or NULL if they have not been
+	 * asked for yet.
+	 */
+	Array *arguments;
+
+	/**
+	 * An owned reference to the Arena holding @buffer and the items, or NULL
+	 * if they have been allocated with malloc ().
+	 */
+	Arena *arena;
+};
+
+/**
+ * Allocates a memory space of size "size" and initializes the CommandLine
+ * instance by parsing "text".
+ *
+ * @param size  The memory space to allocate (greater or equal to
+ *              "sizeof (CommandLine)").
+ * @param klass An owned reference to the class of this object (must not be
+ *              NULL).
+ * @param text  The command line to parse (must not be NULL).
+ * @param arena The empty Arena where to build the CommandLine, which is reset
+ *              when it is destroyed, or NULL to use malloc ().
+ *
+ * @return An owned reference to the newly allocated CommandLine.
+ */
+CommandLine *
+command_line_construct (size_t size, void *klass, const char *text,
+	Arena *arena);
+
+/**
+ * Allocates and initializes a new CommandLine object.
+ *
+ * @param text The command line to parse (must not be NULL).
+ *
+ * @return The new CommandLine.
+ */
+static inline CommandLine *
+command_line_new (const char *text);
+
+/**
+ * Allocates and initializes a new CommandLine object built in an Arena.
+ *
+ * @param text  The command line to parse (must not be NULL).
+ * @param arena The empty Arena where to build the CommandLine, which is reset
+ *              when it is destroyed (must not be NULL).
+ *
+ * @return The new CommandLine.
+ */
+static inline CommandLine *
+command_line_new_in_arena (const char *text, Arena *arena);
+
+/**
+ * Returns the words following the first one, i.e. the arguments of an
+ * internal command.
+ *
+ * @param self The CommandLine.
+ *
+ * @return An unowned reference to an Array which must not be modified nor
+ *         referenced.
+ */
+Array *
+command_line_get_arguments (void *self);
+
+static inline size_t
+command_line_get_hash (const void *self);
+
+static inline size_t
+command_line_get_length (const void *self);
+
+static inline const char *
+command_line_get_text (const void *self);
+
+static inline bool
+command_line_is_pipeline (const void *self);
+
+
+// Inline functions:
+
+static inline CommandLine *
+command_line_new (const char *text)
+{
+	return command_line_construct (sizeof (CommandLine),
+		command_line_class_get (), text, NULL);
+}
+
+static inline CommandLine *
+command_line_new_in_arena (const char *text, Arena *arena)
+{
+	assert (arena);
+
+	return command_line_construct (sizeof (CommandLine),
+		command_line_class_get (), text, arena);
+}
+
+static inline size_t
+command_line_get_hash (const void *self)
+{
+	assert (self);
+
+	return COMMAND_LINE (self)->hash;
+}
+
+static inline size_t
+command_line_get_length (const void *self)
+{
+	assert (self);
+
+	return COMMAND_LINE (self)->length;
+}
+
+static inline const char *
+command_line_get_text (const void *self)
+{
+	assert (self);
+
+	return COMMAND_LINE (self)->buffer;
+}
+
+static inline bool
+command_line_is_pipeline (const void *self)
+{
+	assert (self);
+
+	return COMMAND_LINE (self)->pipeline;
+}
+
+#endif
@@ -0,0 +1,291 @@
+/**
+ * This file is a part of Shelldon.
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "histogram.h"
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "object.h"
+
+/**
+ * The number of buckets of each power of 2.
+ */
+#define SUB_BUCKETS (1u << HISTOGRAM_PRECISION)
+
+static inline size_t
+histogram_get_bucket (uint64_t value);
+
+static inline uint64_t
+histogram_get_bucket_end (size_t bucket);
+
+static void
+histogram_ensure_buckets (Histogram *self, size_t n);
+
+static void
+histogram_real_finalize (void *);
+
+static void
+histogram_class_real_finalize (void *);
+
+static HistogramClass *klass = NULL;
+
+HistogramClass *
+histogram_class_allocate (size_t size, void *parent, char *name)
+{
+	assert (name);
+	assert_cmpuint (size, >=, sizeof (HistogramClass));
+
+	HistogramClass *histogram_class = HISTOGRAM_CLASS (object_class_allocate (size, parent, name));
+	if (!histogram_class) // Allocation failed
+	{
+		return NULL;
+	}
+
+	OBJECT_CLASS (histogram_class)->finalize = histogram_real_finalize;
+
+	return histogram_class;
+}
+
+HistogramClass *
+histogram_class_get (void)
+{
+	if (!klass) // The Histogram class is not yet initalized.
+	{
+		klass = histogram_class_allocate (sizeof (HistogramClass), object_class_get (), "Histogram");
+		OBJECT_CLASS (klass)->finalize_class = histogram_class_real_finalize;
+		return klass;
+	}
+
+	return object_class_ref (klass);
+}
+
+Histogram *
+histogram_construct (size_t size, void *klass)
+{
+	assert_cmpuint (size, >=, sizeof (Histogram));
+
+	Histogram *self = HISTOGRAM (object_construct (size, klass));
+
+	self->buckets = NULL;
+	self->n_buckets = 0;
+	self->count = 0;
+	self->total = 0;
+	self->max = 0;
+
+	return self;
+}
+
+void
+histogram_add (void *self, uint64_t value)
+{
+	assert (self);
+
+	Histogram *histogram = HISTOGRAM (self);
+	size_t bucket = histogram_get_bucket (value);
+	histogram_ensure_buckets (histogram, bucket + 1);
+	++histogram->buckets[bucket];
+	++histogram->count;
+	histogram->total += value;
+	if (value > histogram->max)
+	{
+		histogram->max = value;
+	}
+}
+
+void
+histogram_merge (void *self, const void *other)
+{
+	assert (self);
+	assert (other);
+
+	Histogram *histogram = HISTOGRAM (self);
+	const Histogram *source = HISTOGRAM (other);
+	histogram_ensure_buckets (histogram, source->n_buckets);
+	for (size_t i = 0; i < source->n_buckets; ++i)
+	{
+		histogram->buckets[i] += source->buckets[i];
+	}
+	histogram->count += source->count;
+	histogram->total += source->total;
+	if (source->max > histogram->max)
+	{
+		histogram->max = source->max;
+	}
+}
+
+uint64_t
+histogram_get_percentile (const void *self, double p)
+{
+	assert (self);
+
+	const Histogram *histogram = HISTOGRAM (self);
+	if (!histogram->count)
+	{
+		return 0;
+	}
+
+	// The rank of the value, from 1.
+	uint64_t rank = (uint64_t) (p / 100 * (double) histogram->count + 0.5);
+	if (rank < 1)
+	{
+		rank = 1;
+	}
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < histogram->n_buckets; ++i)
+	{
+		seen += histogram->buckets[i];
+		if (seen >= rank)
+		{
+			uint64_t end = histogram_get_bucket_end (i);
+			return (end < histogram->max ? end : histogram->max);
+		}
+	}
+
+	return histogram->max;
+}
+
+void
+histogram_write (const void *self, FILE *stream)
+{
+	assert (self);
+	assert (stream);
+
+	const Histogram *histogram = HISTOGRAM (self);
+	fprintf (stream, "%" PRIu64 " %" PRIu64 " %" PRIu64, histogram->count,
+		histogram->total, histogram->max);
+	for (size_t i = 0; i < histogram->n_buckets; ++i)
+	{
+		if (histogram->buckets[i])
+		{
+			fprintf (stream, " %zu:%" PRIu32, i, histogram->buckets[i]);
+		}
+	}
+}
+
+int
+histogram_read (void *self, const char *text)
+{
+	assert (self);
+	assert (text);
+
+	Histogram *histogram = HISTOGRAM (self);
+	char *end;
+	uint64_t count = strtoull (text, &end, 10);
+	uint64_t total = strtoull (end, &end, 10);
+	uint64_t max = strtoull (end, &end, 10);
+	if (' ' != *end && '\0' != *end)
+	{
+		return -1;
+	}
+
+	uint64_t n = 0;
+	while (' ' == *end)
+	{
+		size_t bucket = strtoul (end + 1, &end, 10);
+		if (':' != *end || bucket > histogram_get_bucket (UINT64_MAX))
+		{
+			return -1;
+		}
+		unsigned long bucket_count = strtoul (end + 1, &end, 10);
+		histogram_ensure_buckets (histogram, bucket + 1);
+		histogram->buckets[bucket] += (uint32_t) bucket_count;
+		n += bucket_count;
+	}
+	if ('\0' != *end || n != count)
+	{
+		return -1;
+	}
+
+	histogram->count += count;
+	histogram->total += total;
+	if (max > histogram->max)
+	{
+		histogram->max = max;
+	}
+
+	return 0;
+}
+
+/**
+ * Returns the bucket of a value: the values lesser than SUB_BUCKETS have their
+ * own one, the others are shifted right until they have HISTOGRAM_PRECISION + 1
+ * bits, the number of shifts telling the group of SUB_BUCKETS buckets.
+ */
+static inline size_t
+histogram_get_bucket (uint64_t value)
+{
+	if (value < SUB_BUCKETS)
+	{
+		return (size_t) value;
+	}
+
+	unsigned int shift = 63 - (unsigned int) __builtin_clzll (value)
+		- HISTOGRAM_PRECISION;
+	return (size_t) shift * SUB_BUCKETS + (size_t) (value >> shift);
+}
+
+/**
+ * Returns the largest value of a bucket.
+ */
+static inline uint64_t
+histogram_get_bucket_end (size_t bucket)
+{
+	if (bucket < 2 * SUB_BUCKETS)
+	{
+		return bucket;
+	}
+
+	unsigned int shift = (unsigned int) (bucket / SUB_BUCKETS) - 1;
+	uint64_t first = (uint64_t) (bucket - shift * SUB_BUCKETS) << shift;
+	return first + ((uint64_t) 1 << shift) - 1;
+}
+
+static void
+histogram_ensure_buckets (Histogram *self, size_t n)
+{
+	if (n <= self->n_buckets)
+	{
+		return;
+	}
+
+	self->buckets = realloc (self->buckets, n * sizeof (uint32_t));
+	assert (self->buckets);
+	memset (self->buckets + self->n_buckets, 0,
+		(n - self->n_buckets) * sizeof (uint32_t));
+	self->n_buckets = n;
+}
+
+static void
+histogram_real_finalize (void *self)
+{
+	assert (self);
+
+	free (HISTOGRAM (self)->buckets);
+
+	assert (klass);
+	object_class_get_parent (klass)->finalize (self);
+}
+
+static void
+histogram_class_real_finalize (void *_klass)
+{
+	assert (_klass == klass);
+	klass = NULL;
+}
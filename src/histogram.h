@@ -0,0 +1,229 @@
+/**
+ * This file is a part of Shelldon.
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "assert.h"
+#include "object.h"
+
+typedef struct Histogram Histogram;
+typedef struct HistogramClass HistogramClass;
+
+#define HISTOGRAM(pointer) ((Histogram *) pointer)
+
+#define HISTOGRAM_CLASS(pointer) ((HistogramClass *) pointer)
+
+/**
+ * The number of bits of the values kept by the buckets: the values are
+ * rounded to 2^HISTOGRAM_PRECISION significant binary digits (about 3%).
+ */
+#define HISTOGRAM_PRECISION 5
+
+/**
+ * Represents the Histogram class or a Histogram-based class.
+ */
+struct HistogramClass {
+	ObjectClass parent;
+};
+
+/**
+ * Allocates and initializes a new Histogram-based class of size "size" with
+ * name "name".
+ *
+ * This function is only useful to create a Histogram-based class.
+ *
+ * @param size   The size of the structure of the class to allocate (must be
+ *               greater or equal to "sizeof (HistogramClass)".
+ * @param parent An owned reference to the parent class.
+ * @param name   The name of the class (must not be NULL).
+ *
+ * @return The new allocated memory with all fields filled.
+ */
+HistogramClass *
+histogram_class_allocate (size_t size, void *parent, char *name);
+
+/**
+ * Returns an owned reference the Histogram class.
+ *
+ * When no longer needed, the reference should be unreferenced by calling
+ * "object_class_unref (void *)".
+ *
+ * This function is only useful to create a Histogram-based class.
+ *
+ * @return The reference.
+ */
+HistogramClass *
+histogram_class_get (void);
+
+/**
+ * Represents an instance of the Histogram type.
+ *
+ * It counts values (e.g. durations) in buckets whose width grows with the
+ * values, as HDR histograms do: the values lesser than 2^HISTOGRAM_PRECISION
+ * have their own bucket, then each power of 2 is divided into
+ * 2^HISTOGRAM_PRECISION buckets. Their percentiles are thus known with a
+ * bounded relative error, whatever their range, in a few hundred counters.
+ */
+struct Histogram {
+	Object parent;
+
+	/**
+	 * The number of values in each bucket.
+	 */
+	uint32_t *buckets;
+
+	/**
+	 * The number of items of @buckets, which grows with the largest value.
+	 */
+	size_t n_buckets;
+
+	/**
+	 * The number of values.
+	 */
+	uint64_t count;
+
+	/**
+	 * The sum of the values.
+	 */
+	uint64_t total;
+
+	/**
+	 * The largest value.
+	 */
+	uint64_t max;
+};
+
+/**
+ * Allocates a memory space of size "size" and initializes the Histogram
+ * instance.
+ *
+ * @param size  The memory space to allocate (greater or equal to
+ *              "sizeof (Histogram)").
+ * @param klass An owned reference to the class of this object (must not be
+ *              NULL).
+ *
+ * @return An owned reference to the newly allocated Histogram.
+ */
+Histogram *
+histogram_construct (size_t size, void *klass);
+
+/**
+ * Allocates and initializes a new Histogram object.
+ *
+ * @return The new Histogram.
+ */
+static inline Histogram *
+histogram_new (void);
+
+/**
+ * Adds a value.
+ *
+ * @param self  The Histogram.
+ * @param value The value.
+ */
+void
+histogram_add (void *self, uint64_t value);
+
+/**
+ * Adds the values of another Histogram.
+ *
+ * @param self  The Histogram.
+ * @param other The Histogram whose values are added.
+ */
+void
+histogram_merge (void *self, const void *other);
+
+/**
+ * Returns the value below which "p" percent of the values are, rounded up to
+ * the end of its bucket (but not above the largest value).
+ *
+ * @param self The Histogram.
+ * @param p    The percentage (between 0 and 100).
+ *
+ * @return The value, or 0 if the Histogram is empty.
+ */
+uint64_t
+histogram_get_percentile (const void *self, double p);
+
+static inline uint64_t
+histogram_get_count (const void *self);
+
+static inline uint64_t
+histogram_get_max (const void *self);
+
+static inline uint64_t
+histogram_get_total (const void *self);
+
+/**
+ * Writes the Histogram on one line, without its '\n': the number of values,
+ * their sum, the largest one, then "BUCKET:COUNT" for each bucket which is not
+ * empty.
+ *
+ * @param self   The Histogram.
+ * @param stream Where to write.
+ */
+void
+histogram_write (const void *self, FILE *stream);
+
+/**
+ * Adds the values of a Histogram written by histogram_write ().
+ *
+ * @param self The Histogram.
+ * @param text The text written by histogram_write ().
+ *
+ * @return 0 on success, -1 if the text is invalid (the Histogram may have been
+ *         partially modified).
+ */
+int
+histogram_read (void *self, const char *text);
+
+
+// Inline functions:
+
+static inline Histogram *
+histogram_new (void)
+{
+	return histogram_construct (sizeof (Histogram), histogram_class_get ());
+}
+
+static inline uint64_t
+histogram_get_count (const void *self)
+{
+	assert (self);
+
+	return HISTOGRAM (self)->count;
+}
+
+static inline uint64_t
+histogram_get_max (const void *self)
+{
+	assert (self);
+
+	return HISTOGRAM (self)->max;
+}
+
+static inline uint64_t
+histogram_get_total (const void *self)
+{
+	assert (self);
+
+	return HISTOGRAM (self)->total;
+}
+
+#endif
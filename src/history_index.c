@@ -0,0 +1,389 @@
+/**
+ * This file is a part of Shelldon.
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "history_index.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assert.h"
+#include "debug.h"
+#include "object.h"
+
+#define INITIAL_TRIGRAMS_CAPACITY 1024
+
+/**
+ * The maximum number of trigrams of a pattern which are used by
+ * history_index_search (), the rarest ones.
+ */
+#define MAX_SEARCH_TRIGRAMS 8
+
+/**
+ * The key of the trigram starting at "p".
+ */
+#define TRIGRAM_KEY(p) \
+	( (1u << 24) | ((uint32_t) (unsigned char) (p)[0] << 16) \
+		| ((uint32_t) (unsigned char) (p)[1] << 8) | (unsigned char) (p)[2] )
+
+static inline size_t
+history_index_hash (uint32_t key);
+
+static history_index_trigram_t *
+history_index_find_trigram (const HistoryIndex *self, uint32_t key);
+
+static history_index_trigram_t *
+history_index_add_trigram (HistoryIndex *self, uint32_t key);
+
+static bool
+history_index_trigram_contains (const history_index_trigram_t *trigram,
+	uint32_t id);
+
+static void
+history_index_real_finalize (void *);
+
+static void
+history_index_class_real_finalize (void *);
+
+static HistoryIndexClass *klass = NULL;
+
+HistoryIndexClass *
+history_index_class_allocate (size_t size, void *parent, char *name)
+{
+	assert (name);
+	assert_cmpuint (size, >=, sizeof (HistoryIndexClass));
+
+	HistoryIndexClass *history_index_class = HISTORY_INDEX_CLASS (object_class_allocate (size, parent, name));
+	if (!history_index_class) // Allocation failed
+	{
+		return NULL;
+	}
+
+	OBJECT_CLASS (history_index_class)->finalize = history_index_real_finalize;
+
+	return history_index_class;
+}
+
+HistoryIndexClass *
+history_index_class_get (void)
+{
+	if (!klass) // The HistoryIndex class is not yet initalized.
+	{
+		klass = history_index_class_allocate (sizeof (HistoryIndexClass), object_class_get (), "HistoryIndex");
+		OBJECT_CLASS (klass)->finalize_class = history_index_class_real_finalize;
+		return klass;
+	}
+
+	return object_class_ref (klass);
+}
+
+HistoryIndex *
+history_index_construct (size_t size, void *klass)
+{
+	assert_cmpuint (size, >=, sizeof (HistoryIndex));
+
+	HistoryIndex *self = HISTORY_INDEX (object_construct (size, klass));
+
+	self->text = NULL;
+	self->text_size = 0;
+	self->text_capacity = 0;
+	self->offsets = NULL;
+	self->size = 0;
+	self->capacity = 0;
+	self->trigrams = calloc (INITIAL_TRIGRAMS_CAPACITY,
+		sizeof (history_index_trigram_t));
+	assert (self->trigrams);
+	self->n_trigrams = 0;
+	self->trigrams_capacity = INITIAL_TRIGRAMS_CAPACITY;
+
+	return self;
+}
+
+size_t
+history_index_add (void *self, const char *line)
+{
+	assert (self);
+	assert (line);
+
+	HistoryIndex *index = HISTORY_INDEX (self);
+	assert_cmpuint (index->size, <, UINT32_MAX);
+
+	size_t length = strlen (line);
+	if (index->text_size + length + 1 > index->text_capacity)
+	{
+		size_t capacity = (index->text_capacity ? index->text_capacity : 4096);
+		while (index->text_size + length + 1 > capacity)
+		{
+			capacity *= 2;
+		}
+		index->text = realloc (index->text, capacity);
+		assert (index->text);
+		index->text_capacity = capacity;
+	}
+	if (index->size == index->capacity)
+	{
+		index->capacity = (index->capacity ? index->capacity * 2 : 256);
+		index->offsets = realloc (index->offsets,
+			index->capacity * sizeof (size_t));
+		assert (index->offsets);
+	}
+
+	size_t id = index->size++;
+	index->offsets[id] = index->text_size;
+	memcpy (index->text + index->text_size, line, length + 1);
+	index->text_size += length + 1;
+
+	for (size_t i = 0; i + 3 <= length; ++i)
+	{
+		history_index_trigram_t *trigram = history_index_add_trigram (index,
+			TRIGRAM_KEY (line + i));
+
+		// The trigram may appear several times in the line.
+		if (trigram->size && trigram->entries[trigram->size - 1] == id)
+		{
+			continue;
+		}
+		if (trigram->size == trigram->capacity)
+		{
+			trigram->capacity = (trigram->capacity ? trigram->capacity * 2 : 4);
+			trigram->entries = realloc (trigram->entries,
+				trigram->capacity * sizeof (uint32_t));
+			assert (trigram->entries);
+		}
+		trigram->entries[trigram->size++] = (uint32_t) id;
+	}
+
+	return id;
+}
+
+size_t
+history_index_search (const void *self, const char *pattern, size_t before)
+{
+	assert (self);
+	assert (pattern);
+
+	const HistoryIndex *index = HISTORY_INDEX (self);
+	if (before > index->size)
+	{
+		before = index->size;
+	}
+
+	size_t length = strlen (pattern);
+	if (length < 3) // Too short to use the index.
+	{
+		while (before--)
+		{
+			if (strstr (history_index_get (self, before), pattern))
+			{
+				return before;
+			}
+		}
+		return HISTORY_INDEX_NONE;
+	}
+
+	// Keeps the rarest trigrams of the pattern, sorted by their frequency.
+	const history_index_trigram_t *trigrams[MAX_SEARCH_TRIGRAMS];
+	size_t n = 0;
+	for (size_t i = 0; i + 3 <= length; ++i)
+	{
+		const history_index_trigram_t *trigram = history_index_find_trigram (
+			index, TRIGRAM_KEY (pattern + i));
+		if (!trigram) // No command line contains it.
+		{
+			return HISTORY_INDEX_NONE;
+		}
+
+		bool known = false;
+		for (size_t j = 0; j < n && !known; ++j)
+		{
+			known = (trigrams[j] == trigram);
+		}
+		if (known || (n == MAX_SEARCH_TRIGRAMS
+			&& trigram->size >= trigrams[n - 1]->size))
+		{
+			continue;
+		}
+
+		// When full, the most frequent trigram is replaced.
+		size_t j = (n < MAX_SEARCH_TRIGRAMS ? n++ : n - 1);
+		while (j > 0 && trigrams[j - 1]->size > trigram->size)
+		{
+			trigrams[j] = trigrams[j - 1];
+			--j;
+		}
+		trigrams[j] = trigram;
+	}
+
+	// The candidates are the entries of the rarest trigram, from the end.
+	const history_index_trigram_t *rarest = trigrams[0];
+	size_t low = 0;
+	size_t high = rarest->size;
+	while (low < high) // Finds the first entry which is not before "before".
+	{
+		size_t middle = low + (high - low) / 2;
+		if (rarest->entries[middle] < before)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	while (low--)
+	{
+		uint32_t id = rarest->entries[low];
+		size_t i = 1;
+		while (i < n && history_index_trigram_contains (trigrams[i], id))
+		{
+			++i;
+		}
+
+		// The trigrams may not be contiguous in the command line.
+		if (i == n && strstr (history_index_get (self, id), pattern))
+		{
+			return id;
+		}
+	}
+
+	return HISTORY_INDEX_NONE;
+}
+
+/**
+ * Spreads the bits of a trigram key, whose low bits only depend on its last
+ * character.
+ */
+static inline size_t
+history_index_hash (uint32_t key)
+{
+	uint32_t hash = key * 2654435761u;
+	return hash ^ (hash >> 16);
+}
+
+static history_index_trigram_t *
+history_index_find_trigram (const HistoryIndex *self, uint32_t key)
+{
+	size_t mask = self->trigrams_capacity - 1;
+	for (size_t i = history_index_hash (key) & mask; self->trigrams[i].key;
+		i = (i + 1) & mask)
+	{
+		if (self->trigrams[i].key == key)
+		{
+			return self->trigrams + i;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Returns the trigram of key "key", which is inserted if it is not found.
+ */
+static history_index_trigram_t *
+history_index_add_trigram (HistoryIndex *self, uint32_t key)
+{
+	size_t mask = self->trigrams_capacity - 1;
+	size_t i = history_index_hash (key) & mask;
+	for (; self->trigrams[i].key; i = (i + 1) & mask)
+	{
+		if (self->trigrams[i].key == key)
+		{
+			return self->trigrams + i;
+		}
+	}
+
+	// Keeps the load factor under 1/2.
+	if (2 * (self->n_trigrams + 1) > self->trigrams_capacity)
+	{
+		size_t capacity = self->trigrams_capacity * 2;
+		history_index_trigram_t *trigrams = calloc (capacity,
+			sizeof (history_index_trigram_t));
+		assert (trigrams);
+
+		for (size_t j = 0; j < self->trigrams_capacity; ++j)
+		{
+			if (self->trigrams[j].key)
+			{
+				size_t k = history_index_hash (self->trigrams[j].key) & (capacity - 1);
+				while (trigrams[k].key)
+				{
+					k = (k + 1) & (capacity - 1);
+				}
+				trigrams[k] = self->trigrams[j];
+			}
+		}
+
+		free (self->trigrams);
+		self->trigrams = trigrams;
+		self->trigrams_capacity = capacity;
+		debug ("New HistoryIndex trigrams capacity: %zu", capacity);
+
+		return history_index_add_trigram (self, key);
+	}
+
+	++self->n_trigrams;
+	self->trigrams[i].key = key;
+	return self->trigrams + i;
+}
+
+/**
+ * Returns true if "trigram" is contained in the entry "id" (binary search).
+ */
+static bool
+history_index_trigram_contains (const history_index_trigram_t *trigram,
+	uint32_t id)
+{
+	size_t low = 0;
+	size_t high = trigram->size;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (trigram->entries[middle] < id)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return (low < trigram->size && trigram->entries[low] == id);
+}
+
+static void
+history_index_real_finalize (void *self)
+{
+	assert (self);
+
+	for (size_t i = 0; i < HISTORY_INDEX (self)->trigrams_capacity; ++i)
+	{
+		free (HISTORY_INDEX (self)->trigrams[i].entries);
+	}
+	free (HISTORY_INDEX (self)->trigrams);
+	free (HISTORY_INDEX (self)->offsets);
+	free (HISTORY_INDEX (self)->text);
+
+	assert (klass);
+	object_class_get_parent (klass)->finalize (self);
+}
+
+static void
+history_index_class_real_finalize (void *_klass)
+{
+	assert (_klass == klass);
+	klass = NULL;
+}
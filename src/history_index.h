@@ -0,0 +1,247 @@
+/**
+ * This file is a part of Shelldon.
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef HISTORY_INDEX_H
+#define HISTORY_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "assert.h"
+#include "object.h"
+
+typedef struct HistoryIndex HistoryIndex;
+typedef struct HistoryIndexClass HistoryIndexClass;
+
+#define HISTORY_INDEX(pointer) ((HistoryIndex *) pointer)
+
+#define HISTORY_INDEX_CLASS(pointer) ((HistoryIndexClass *) pointer)
+
+/**
+ * Returned by history_index_search () when nothing matches.
+ */
+#define HISTORY_INDEX_NONE ((size_t) -1)
+
+/**
+ * Represents the HistoryIndex class or a HistoryIndex-based class.
+ */
+struct HistoryIndexClass {
+	ObjectClass parent;
+};
+
+/**
+ * Allocates and initializes a new HistoryIndex-based class of size "size" with
+ * name "name".
+ *
+ * This function is only useful to create a HistoryIndex-based class.
+ *
+ * @param size   The size of the structure of the class to allocate (must be
+ *               greater or equal to "sizeof (HistoryIndexClass)".
+ * @param parent An owned reference to the parent class.
+ * @param name   The name of the class (must not be NULL).
+ *
+ * @return The new allocated memory with all fields filled.
+ */
+HistoryIndexClass *
+history_index_class_allocate (size_t size, void *parent, char *name);
+
+/**
+ * Returns an owned reference the HistoryIndex class.
+ *
+ * When no longer needed, the reference should be unreferenced by calling
+ * "object_class_unref (void *)".
+ *
+ * This function is only useful to create a HistoryIndex-based class.
+ *
+ * @return The reference.
+ */
+HistoryIndexClass *
+history_index_class_get (void);
+
+/**
+ * The entries containing a trigram.
+ */
+typedef struct
+{
+	/**
+	 * The three characters (the highest byte is 1 so that 0 means an unused
+	 * slot).
+	 */
+	uint32_t key;
+
+	/**
+	 * The number of items of @entries.
+	 */
+	uint32_t size;
+
+	/**
+	 * The number of items @entries can contain.
+	 */
+	uint32_t capacity;
+
+	/**
+	 * The entries, in increasing order.
+	 */
+	uint32_t *entries;
+} history_index_trigram_t;
+
+/**
+ * Represents an instance of the HistoryIndex type.
+ *
+ * It holds a copy of command lines, numbered from 0 in the order they are
+ * added, and an index of their trigrams (all the sequences of three
+ * characters) so that the ones containing a string can be found without
+ * reading them all.
+ */
+struct HistoryIndex {
+	Object parent;
+
+	/**
+	 * The command lines, separated by '\0'.
+	 */
+	char *text;
+
+	/**
+	 * The number of characters used in @text.
+	 */
+	size_t text_size;
+
+	/**
+	 * The number of characters allocated for @text.
+	 */
+	size_t text_capacity;
+
+	/**
+	 * The offsets of the command lines in @text.
+	 */
+	size_t *offsets;
+
+	/**
+	 * The number of command lines.
+	 */
+	size_t size;
+
+	/**
+	 * The number of items allocated for @offsets.
+	 */
+	size_t capacity;
+
+	/**
+	 * Open addressing hash table (linear probing) of the trigrams.
+	 */
+	history_index_trigram_t *trigrams;
+
+	/**
+	 * The number of used slots of @trigrams.
+	 */
+	size_t n_trigrams;
+
+	/**
+	 * The number of slots of @trigrams (always a power of 2).
+	 */
+	size_t trigrams_capacity;
+};
+
+/**
+ * Allocates a memory space of size "size" and initializes the HistoryIndex
+ * instance.
+ *
+ * @param size  The memory space to allocate (greater or equal to
+ *              "sizeof (HistoryIndex)").
+ * @param klass An owned reference to the class of this object (must not be
+ *              NULL).
+ *
+ * @return An owned reference to the newly allocated HistoryIndex.
+ */
+HistoryIndex *
+history_index_construct (size_t size, void *klass);
+
+/**
+ * Allocates and initializes a new HistoryIndex object.
+ *
+ * @return The new HistoryIndex.
+ */
+static inline HistoryIndex *
+history_index_new (void);
+
+/**
+ * Adds a command line to the index.
+ *
+ * @param self The HistoryIndex.
+ * @param line The command line.
+ *
+ * @return The number of the command line.
+ */
+size_t
+history_index_add (void *self, const char *line);
+
+/**
+ * Returns a command line.
+ *
+ * @param self The HistoryIndex.
+ * @param id   The number of the command line (must be lesser than the
+ *             HistoryIndex's size).
+ *
+ * @return The command line, which is valid until the next one is added.
+ */
+static inline const char *
+history_index_get (const void *self, size_t id);
+
+static inline size_t
+history_index_get_size (const void *self);
+
+/**
+ * Looks for the most recent command line containing "pattern" among the ones
+ * numbered below "before".
+ *
+ * Patterns shorter than three characters cannot use the index: the command
+ * lines are read until one matches.
+ *
+ * @param self    The HistoryIndex.
+ * @param pattern The string to look for (must not be NULL).
+ * @param before  The number following the last command line to consider (the
+ *                HistoryIndex's size to consider all of them).
+ *
+ * @return The number of the command line or HISTORY_INDEX_NONE.
+ */
+size_t
+history_index_search (const void *self, const char *pattern, size_t before);
+
+
+// Inline functions:
+
+static inline HistoryIndex *
+history_index_new (void)
+{
+	return history_index_construct (sizeof (HistoryIndex),
+		history_index_class_get ());
+}
+
+static inline const char *
+history_index_get (const void *self, size_t id)
+{
+	assert_cmpuint (id, <, HISTORY_INDEX (self)->size);
+
+	return HISTORY_INDEX (self)->text + HISTORY_INDEX (self)->offsets[id];
+}
+
+static inline size_t
+history_index_get_size (const void *self)
+{
+	assert (self);
+
+	return HISTORY_INDEX (self)->size;
+}
+
+#endif
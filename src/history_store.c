@@ -0,0 +1,1062 @@
+/**
+ * This file is a part of Shelldon.
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "history_store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "array.h"
+#include "assert.h"
+#include "debug.h"
+#include "object.h"
+#include "string.h"
+
+#define RECORD_ALIGNMENT 8
+
+/**
+ * The size of a record holding a command line of length "length".
+ */
+#define RECORD_SIZE(length) \
+	( (sizeof (history_record_t) + (length) + 1 + sizeof (uint32_t) \
+		+ RECORD_ALIGNMENT - 1) & ~ (size_t) (RECORD_ALIGNMENT - 1) )
+
+#define MIN_RECORD_SIZE RECORD_SIZE (0)
+
+/**
+ * How long a shell which finds a partial record at the end of the file waits
+ * before deciding that it is not being written by another shell.
+ */
+#define TORN_RECORD_DELAY_NS (50 * 1000 * 1000)
+
+static uint32_t
+history_store_new_session (void);
+
+static int
+history_store_open (HistoryStore *self);
+
+static int
+history_store_create (HistoryStore *self);
+
+static int
+history_store_replace (HistoryStore *self, const char *buffer, size_t size,
+	size_t copied);
+
+static int
+history_store_write_records (HistoryStore *self, const char *buffer,
+	size_t size);
+
+static bool
+history_store_contains (const HistoryStore *self,
+	const history_record_t *record);
+
+static size_t
+history_store_find_position (const HistoryStore *self);
+
+static void
+history_store_remember (HistoryStore *self, const history_record_t *record);
+
+static int
+history_store_map (HistoryStore *self);
+
+static void
+history_store_unmap (HistoryStore *self);
+
+static size_t
+history_store_get_valid_size (const HistoryStore *self, size_t offset);
+
+static size_t
+history_store_get_end (const HistoryStore *self);
+
+static const history_record_t *
+history_store_get_record_before (const HistoryStore *self, size_t end);
+
+static size_t
+history_store_collect (HistoryStore *self, size_t n, size_t max_size,
+	Array *records);
+
+static size_t
+history_store_write_record (char *buffer, const char *line, size_t length,
+	time_t time, uint32_t session, uint32_t sequence);
+
+static void
+history_store_real_finalize (void *);
+
+static void
+history_store_class_real_finalize (void *);
+
+static HistoryStoreClass *klass = NULL;
+
+HistoryStoreClass *
+history_store_class_allocate (size_t size, void *parent, char *name)
+{
+	assert (name);
+	assert_cmpuint (size, >=, sizeof (HistoryStoreClass));
+
+	HistoryStoreClass *history_store_class = HISTORY_STORE_CLASS (object_class_allocate (size, parent, name));
+	if (!history_store_class) // Allocation failed
+	{
+		return NULL;
+	}
+
+	OBJECT_CLASS (history_store_class)->finalize = history_store_real_finalize;
+
+	return history_store_class;
+}
+
+HistoryStoreClass *
+history_store_class_get (void)
+{
+	if (!klass) // The HistoryStore class is not yet initalized.
+	{
+		klass = history_store_class_allocate (sizeof (HistoryStoreClass), object_class_get (), "HistoryStore");
+		OBJECT_CLASS (klass)->finalize_class = history_store_class_real_finalize;
+		return klass;
+	}
+
+	return object_class_ref (klass);
+}
+
+HistoryStore *
+history_store_construct (size_t size, void *klass, const char *path)
+{
+	assert_cmpuint (size, >=, sizeof (HistoryStore));
+	assert (path);
+
+	HistoryStore *self = HISTORY_STORE (object_construct (size, klass));
+
+	self->path = strdup (path);
+	self->fd = -1;
+	self->map = NULL;
+	self->map_size = 0;
+	self->size = 0;
+	self->device = 0;
+	self->inode = 0;
+	self->mtime.tv_sec = 0;
+	self->mtime.tv_nsec = 0;
+	self->position = 0;
+	self->last_session = 0;
+	self->last_sequence = 0;
+	self->last_time = 0;
+	self->session = history_store_new_session ();
+	self->sequence = 0;
+
+	return self;
+}
+
+int
+history_store_append (void *self, const char *line, time_t time)
+{
+	assert (self);
+	assert (line);
+
+	if (-1 == history_store_open (self))
+	{
+		return -1;
+	}
+
+	size_t length = strlen (line);
+	if (length > UINT32_MAX - MIN_RECORD_SIZE)
+	{
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	char small_buffer[256];
+	size_t size = RECORD_SIZE (length);
+	char *buffer = (size <= sizeof (small_buffer) ? small_buffer : malloc (size));
+	if (!buffer)
+	{
+		return -1;
+	}
+	history_store_write_record (buffer, line, length, time,
+		HISTORY_STORE (self)->session, ++HISTORY_STORE (self)->sequence);
+
+	int result = history_store_write_records (self, buffer, size);
+	if (buffer != small_buffer)
+	{
+		free (buffer);
+	}
+
+	return result;
+}
+
+int
+history_store_clear (void *self)
+{
+	assert (self);
+
+	if (-1 == history_store_open (self))
+	{
+		return -1;
+	}
+
+	history_store_unmap (self);
+	if (-1 == ftruncate (HISTORY_STORE (self)->fd, HISTORY_STORE_HEADER_SIZE))
+	{
+		return -1;
+	}
+	HISTORY_STORE (self)->size = HISTORY_STORE_HEADER_SIZE;
+	HISTORY_STORE (self)->position = HISTORY_STORE_HEADER_SIZE;
+
+	return 0;
+}
+
+void
+history_store_close (void *self)
+{
+	assert (self);
+
+	history_store_unmap (self);
+	if (-1 != HISTORY_STORE (self)->fd)
+	{
+		close (HISTORY_STORE (self)->fd);
+		HISTORY_STORE (self)->fd = -1;
+	}
+}
+
+int
+history_store_compact (void *self, size_t max_size)
+{
+	assert (self);
+	assert_cmpuint (max_size, >=, HISTORY_STORE_HEADER_SIZE);
+
+	if (-1 == history_store_map (self))
+	{
+		return -1;
+	}
+
+	/*
+	 * Several shells may compact the file at once: the other ones do nothing,
+	 * otherwise the records appended to the file of the first one would be
+	 * lost when the next one replaces it. The appends do not need the lock.
+	 */
+	struct stat st;
+	struct stat path_st;
+	if (-1 == flock (HISTORY_STORE (self)->fd, LOCK_EX | LOCK_NB)
+		|| -1 == fstat (HISTORY_STORE (self)->fd, &st)
+		|| -1 == stat (HISTORY_STORE (self)->path, &path_st)
+		|| st.st_ino != path_st.st_ino || st.st_dev != path_st.st_dev)
+	{
+		debug ("History store being or already compacted");
+		history_store_close (self);
+		return 0;
+	}
+
+	Array *records = array_new (NULL);
+	size_t size = HISTORY_STORE_HEADER_SIZE + history_store_collect (self,
+		(size_t) -1, max_size - HISTORY_STORE_HEADER_SIZE, records);
+
+	char *buffer = malloc (size);
+	if (!buffer)
+	{
+		object_unref (records);
+		return -1;
+	}
+	memcpy (buffer, HISTORY_STORE_MAGIC, HISTORY_STORE_HEADER_SIZE);
+	char *p = buffer + HISTORY_STORE_HEADER_SIZE;
+	for (size_t i = array_get_size (records); i > 0; --i) // Oldest first.
+	{
+		const history_record_t *record = array_get (records, i - 1);
+		memcpy (p, record, record->size);
+		p += record->size;
+	}
+	object_unref (records);
+
+	size_t old_size = HISTORY_STORE (self)->map_size;
+	int result = history_store_replace (self, buffer, size, old_size);
+	if (0 == result)
+	{
+		debug ("History store compacted: %zu -> %zu bytes", old_size, size);
+	}
+	free (buffer);
+
+	return result;
+}
+
+int
+history_store_export (void *self, const char *file)
+{
+	assert (self);
+	assert (file);
+
+	if (-1 == history_store_map (self))
+	{
+		return -1;
+	}
+
+	FILE *stream = fopen (file, "w");
+	if (!stream)
+	{
+		return -1;
+	}
+
+	const char *map = HISTORY_STORE (self)->map;
+	size_t end = history_store_get_valid_size (self, HISTORY_STORE_HEADER_SIZE);
+	for (size_t offset = HISTORY_STORE_HEADER_SIZE; offset < end;)
+	{
+		const history_record_t *record = (const history_record_t *) (map + offset);
+		fwrite (record->text, 1, record->length, stream);
+		putc ('\n', stream);
+		offset += record->size;
+	}
+
+	return fclose (stream);
+}
+
+bool
+history_store_exists (void *self)
+{
+	assert (self);
+
+	return (-1 != HISTORY_STORE (self)->fd
+		|| 0 == access (HISTORY_STORE (self)->path, F_OK));
+}
+
+const history_record_t *
+history_store_get_last (void *self)
+{
+	assert (self);
+
+	if (-1 == history_store_map (self))
+	{
+		return NULL;
+	}
+
+	return history_store_get_record_before (self, HISTORY_STORE (self)->map_size);
+}
+
+const history_record_t *
+history_store_get_previous (const void *self, const history_record_t *record)
+{
+	assert (self);
+	assert (record);
+
+	const char *start = (const char *) record;
+	assert (start > HISTORY_STORE (self)->map);
+
+	return history_store_get_record_before (self,
+		(size_t) (start - HISTORY_STORE (self)->map));
+}
+
+size_t
+history_store_get_recent (void *self, size_t n, Array *records)
+{
+	assert (self);
+	assert (records);
+
+	if (-1 == history_store_map (self))
+	{
+		return 0;
+	}
+
+	size_t old_size = array_get_size (records);
+	history_store_collect (self, n, (size_t) -1, records);
+
+	return array_get_size (records) - old_size;
+}
+
+size_t
+history_store_read_new (void *self, Array *records)
+{
+	assert (self);
+	assert (records);
+
+	// The records of the file are all known once it is opened the first time.
+	HistoryStore *store = HISTORY_STORE (self);
+	if (-1 == history_store_open (store))
+	{
+		return 0;
+	}
+
+	// The cheap check made before each command line.
+	struct stat st;
+	if (-1 == stat (store->path, &st))
+	{
+		return 0;
+	}
+	if (st.st_dev == store->device && st.st_ino == store->inode)
+	{
+		if ((size_t) st.st_size == store->position
+			&& st.st_mtim.tv_sec == store->mtime.tv_sec
+			&& st.st_mtim.tv_nsec == store->mtime.tv_nsec)
+		{
+			return 0;
+		}
+	}
+	else // Replaced, the position is looked for in the new file by opening it.
+	{
+		history_store_close (store);
+		if (-1 == history_store_open (store))
+		{
+			return 0;
+		}
+	}
+
+	if (-1 == history_store_map (store))
+	{
+		return 0;
+	}
+
+	// The file may have been cleared (and appended to again) meanwhile.
+	const history_record_t *last = history_store_get_record_before (store,
+		store->position);
+	if (store->position > HISTORY_STORE_HEADER_SIZE && (!last
+		|| last->session != store->last_session
+		|| last->sequence != store->last_sequence))
+	{
+		store->position = history_store_find_position (store);
+	}
+
+	size_t old_size = array_get_size (records);
+	size_t end = history_store_get_valid_size (store, store->position);
+	for (size_t offset = store->position; offset < end;)
+	{
+		const history_record_t *record = (const history_record_t *) (store->map + offset);
+		if (record->session != store->session)
+		{
+			array_append (records, (void *) record);
+		}
+		last = record;
+		offset += record->size;
+	}
+	if (end != store->position)
+	{
+		history_store_remember (store, last);
+		store->position = end;
+	}
+	store->mtime = st.st_mtim;
+
+	return array_get_size (records) - old_size;
+}
+
+int
+history_store_import (void *self, const char *file)
+{
+	assert (self);
+	assert (file);
+
+	FILE *stream = fopen (file, "r");
+	if (!stream)
+	{
+		return -1;
+	}
+	if (-1 == history_store_open (self))
+	{
+		fclose (stream);
+		return -1;
+	}
+
+	// The records are built in memory and written at once.
+	char *buffer = NULL;
+	size_t size = 0;
+	size_t capacity = 0;
+
+	char *line = NULL;
+	size_t line_capacity = 0;
+	ssize_t length;
+	while (-1 != (length = getline (&line, &line_capacity, stream)))
+	{
+		if (length && '\n' == line[length - 1])
+		{
+			line[--length] = '\0';
+		}
+		if (!length || '#' == *line)
+		{
+			continue;
+		}
+
+		size_t record_size = RECORD_SIZE ((size_t) length);
+		if (size + record_size > capacity)
+		{
+			capacity = (capacity ? capacity * 2 : 4096);
+			while (size + record_size > capacity)
+			{
+				capacity *= 2;
+			}
+			char *new_buffer = realloc (buffer, capacity);
+			assert (new_buffer);
+			buffer = new_buffer;
+		}
+		size += history_store_write_record (buffer + size, line,
+			(size_t) length, 0, HISTORY_STORE (self)->session,
+			++HISTORY_STORE (self)->sequence);
+	}
+	free (line);
+	fclose (stream);
+
+	int result = (size ? history_store_write_records (self, buffer, size) : 0);
+	free (buffer);
+
+	return result;
+}
+
+/**
+ * Returns a random number identifying a HistoryStore (never 0).
+ */
+static uint32_t
+history_store_new_session (void)
+{
+	struct timespec now;
+	clock_gettime (CLOCK_REALTIME, &now);
+
+	// The bits of the process id and of the time are mixed (splitmix64).
+	uint64_t seed = ((uint64_t) getpid () << 32)
+		^ ((uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec);
+	seed = (seed ^ (seed >> 30)) * 0xbf58476d1ce4e5b9u;
+	seed = (seed ^ (seed >> 27)) * 0x94d049bb133111ebu;
+	seed ^= seed >> 31;
+
+	uint32_t session = (uint32_t) (seed ^ (seed >> 32));
+	return (session ? session : 1);
+}
+
+/**
+ * Opens the file (creating it if needed) if it is not opened.
+ *
+ * A record may have been partially written if a shell has been interrupted,
+ * in which case the file is truncated after its last complete record.
+ *
+ * The position is set after the last record known if the file is opened
+ * again, at its end otherwise.
+ */
+static int
+history_store_open (HistoryStore *self)
+{
+	if (-1 != self->fd)
+	{
+		return 0;
+	}
+
+	self->fd = open (self->path, O_RDWR | O_APPEND | O_CLOEXEC);
+	if (-1 == self->fd && ENOENT == errno && 0 == history_store_create (self))
+	{
+		self->fd = open (self->path, O_RDWR | O_APPEND | O_CLOEXEC);
+	}
+	if (-1 == self->fd)
+	{
+		return -1;
+	}
+
+	char magic[HISTORY_STORE_HEADER_SIZE];
+	struct stat st;
+	if (sizeof (magic) != pread (self->fd, magic, sizeof (magic), 0)
+		|| memcmp (magic, HISTORY_STORE_MAGIC, sizeof (magic))
+		|| -1 == fstat (self->fd, &st))
+	{
+		fprintf (stderr, "%s is not a history file.\n", self->path);
+		close (self->fd);
+		self->fd = -1;
+		errno = EINVAL;
+		return -1;
+	}
+	self->device = st.st_dev;
+	self->inode = st.st_ino;
+	self->mtime = st.st_mtim;
+
+	if (-1 == history_store_map (self))
+	{
+		return -1;
+	}
+	if (self->map_size > HISTORY_STORE_HEADER_SIZE
+		&& !history_store_get_record_before (self, self->map_size))
+	{
+		// Unless another shell is writing it: the size would change meanwhile.
+		struct timespec delay = { 0, TORN_RECORD_DELAY_NS };
+		nanosleep (&delay, NULL);
+		if (0 == fstat (self->fd, &st) && (size_t) st.st_size == self->map_size)
+		{
+			size_t size = history_store_get_valid_size (self,
+				HISTORY_STORE_HEADER_SIZE);
+			debug ("Truncating the history store after %zu bytes", size);
+			history_store_unmap (self);
+			if (-1 == ftruncate (self->fd, (off_t) size))
+			{
+				return -1;
+			}
+			self->size = size;
+			if (-1 == history_store_map (self))
+			{
+				return -1;
+			}
+		}
+	}
+
+	if (self->last_session || self->last_time)
+	{
+		self->position = history_store_find_position (self);
+	}
+	else
+	{
+		self->position = history_store_get_end (self);
+		const history_record_t *last = history_store_get_record_before (self,
+			self->position);
+		if (last)
+		{
+			history_store_remember (self, last);
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Creates the file with its header only.
+ *
+ * The header is written to a temporary file which is then linked, so that
+ * another shell never sees the file without its header.
+ */
+static int
+history_store_create (HistoryStore *self)
+{
+	char *tmp = string_concat (NULL, self->path, ".XXXXXX", NULL);
+	int fd = mkstemp (tmp);
+	if (-1 == fd)
+	{
+		free (tmp);
+		return -1;
+	}
+
+	int result = 0;
+	if (HISTORY_STORE_HEADER_SIZE != write (fd, HISTORY_STORE_MAGIC,
+			HISTORY_STORE_HEADER_SIZE)
+		|| (-1 == link (tmp, self->path) && EEXIST != errno))
+	{
+		result = -1;
+	}
+
+	int error = errno;
+	close (fd);
+	unlink (tmp);
+	free (tmp);
+
+	errno = error;
+	return result;
+}
+
+/**
+ * Replaces the file atomically by a file containing "size" bytes of "buffer".
+ *
+ * If "copied" is not 0, the records appended to the file after this offset
+ * (by other shells, while "buffer" was built) are copied at the end of the new
+ * one once it has replaced the file. The shells appending to the file after
+ * that see that it has been replaced and append their records again (see
+ * history_store_write_records ()).
+ */
+static int
+history_store_replace (HistoryStore *self, const char *buffer, size_t size,
+	size_t copied)
+{
+	// The copy is written beside the file.
+	char *tmp = string_concat (NULL, self->path, ".XXXXXX", NULL);
+	int fd = mkstemp (tmp);
+	if (-1 == fd)
+	{
+		free (tmp);
+		return -1;
+	}
+
+	int result = 0;
+	if (write (fd, buffer, size) != (ssize_t) size || -1 == fsync (fd)
+		|| -1 == rename (tmp, self->path))
+	{
+		result = -1;
+		unlink (tmp);
+	}
+	else if (copied && 0 == history_store_map (self) && self->map_size > copied)
+	{
+		// The other shells may already be appending to the new file.
+		size_t end = history_store_get_valid_size (self, copied);
+		if (-1 == fcntl (fd, F_SETFL, O_APPEND)
+			|| write (fd, self->map + copied, end - copied) != (ssize_t) (end - copied))
+		{
+			result = -1;
+		}
+	}
+
+	int error = errno;
+	close (fd);
+	free (tmp);
+
+	// The file which is opened is not the right one anymore.
+	history_store_close (self);
+
+	errno = error;
+	return result;
+}
+
+/**
+ * Appends "size" bytes of records with a single write, so that the records of
+ * several shells are not mixed.
+ *
+ * If the file has been replaced by another process meanwhile, the new file is
+ * opened and the records are written again, unless they have been copied in
+ * it.
+ */
+static int
+history_store_write_records (HistoryStore *self, const char *buffer,
+	size_t size)
+{
+	uint32_t last_size;
+	memcpy (&last_size, buffer + size - sizeof (last_size), sizeof (last_size));
+	const history_record_t *last = (const history_record_t *) (buffer + size - last_size);
+
+	while (true)
+	{
+		if (-1 == history_store_open (self))
+		{
+			return -1;
+		}
+
+		ssize_t written = write (self->fd, buffer, size);
+		if (written != (ssize_t) size)
+		{
+			if (written >= 0)
+			{
+				errno = ENOSPC;
+			}
+			return -1;
+		}
+
+		struct stat st;
+		off_t end = lseek (self->fd, 0, SEEK_CUR);
+		if (-1 == end || -1 == fstat (self->fd, &st))
+		{
+			return -1;
+		}
+		if (st.st_nlink) // The file has not been replaced.
+		{
+			self->size = (size_t) st.st_size;
+
+			// The position is only moved if no record is left unread.
+			if (self->position + size == (size_t) end)
+			{
+				self->position = (size_t) end;
+				history_store_remember (self, last);
+				if ((size_t) end == self->size)
+				{
+					self->mtime = st.st_mtim;
+				}
+			}
+			return 0;
+		}
+
+		history_store_close (self);
+		if (-1 == history_store_open (self))
+		{
+			return -1;
+		}
+		if (history_store_contains (self, last))
+		{
+			return 0;
+		}
+		debug ("History store replaced while appending, appending again");
+	}
+}
+
+/**
+ * Returns true if the file contains a record with the same session and
+ * sequence number as "record", looking for it from the end of the file.
+ */
+static bool
+history_store_contains (const HistoryStore *self,
+	const history_record_t *record)
+{
+	for (const history_record_t *p = history_store_get_record_before (self,
+			history_store_get_end (self));
+		p && p->time >= record->time;
+		p = history_store_get_previous (self, p))
+	{
+		if (p->session == record->session && p->sequence == record->sequence)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Returns the offset following the last record known, looking for it from
+ * the end of the file. If it is not found (it may have been removed as a
+ * duplicate), the offset following the last older record is returned.
+ */
+static size_t
+history_store_find_position (const HistoryStore *self)
+{
+	size_t end = history_store_get_end (self);
+	for (const history_record_t *record = history_store_get_record_before (self,
+			end);
+		record;
+		record = history_store_get_previous (self, record))
+	{
+		if ((record->session == self->last_session
+				&& record->sequence == self->last_sequence)
+			|| record->time < self->last_time)
+		{
+			return (size_t) ((const char *) record - self->map) + record->size;
+		}
+	}
+
+	return HISTORY_STORE_HEADER_SIZE;
+}
+
+/**
+ * Makes "record" the last record known.
+ */
+static void
+history_store_remember (HistoryStore *self, const history_record_t *record)
+{
+	self->last_session = record->session;
+	self->last_sequence = record->sequence;
+	self->last_time = record->time;
+}
+
+/**
+ * Maps the file, or maps it again if its size has changed.
+ */
+static int
+history_store_map (HistoryStore *self)
+{
+	if (-1 == self->fd && -1 == history_store_open (self))
+	{
+		return -1;
+	}
+
+	struct stat st;
+	if (-1 == fstat (self->fd, &st))
+	{
+		return -1;
+	}
+	self->size = (size_t) st.st_size;
+	if (self->map && self->map_size == self->size)
+	{
+		return 0;
+	}
+
+	history_store_unmap (self);
+	void *map = mmap (NULL, self->size, PROT_READ, MAP_SHARED, self->fd, 0);
+	if (MAP_FAILED == map)
+	{
+		return -1;
+	}
+	self->map = map;
+	self->map_size = self->size;
+
+	return 0;
+}
+
+static void
+history_store_unmap (HistoryStore *self)
+{
+	if (self->map)
+	{
+		munmap ((void *) self->map, self->map_size);
+		self->map = NULL;
+		self->map_size = 0;
+	}
+}
+
+/**
+ * Reads the mapping from the record at "offset" and returns the offset
+ * following the last complete record.
+ */
+static size_t
+history_store_get_valid_size (const HistoryStore *self, size_t offset)
+{
+	while (offset + MIN_RECORD_SIZE <= self->map_size)
+	{
+		const history_record_t *record = (const history_record_t *) (self->map + offset);
+		if (record->size < MIN_RECORD_SIZE || record->size > self->map_size - offset
+			|| history_store_get_record_before (self, offset + record->size) != record)
+		{
+			break;
+		}
+		offset += record->size;
+	}
+
+	return offset;
+}
+
+/**
+ * Returns the offset following the last complete record of the mapping, which
+ * is only read from its beginning if a record is being written.
+ */
+static size_t
+history_store_get_end (const HistoryStore *self)
+{
+	if (self->map_size <= HISTORY_STORE_HEADER_SIZE
+		|| history_store_get_record_before (self, self->map_size))
+	{
+		return (self->map_size < HISTORY_STORE_HEADER_SIZE
+			? HISTORY_STORE_HEADER_SIZE : self->map_size);
+	}
+
+	return history_store_get_valid_size (self, HISTORY_STORE_HEADER_SIZE);
+}
+
+/**
+ * Returns the record ending at offset "end" of the mapping, or NULL if there
+ * is no valid record there.
+ */
+static const history_record_t *
+history_store_get_record_before (const HistoryStore *self, size_t end)
+{
+	if (end < HISTORY_STORE_HEADER_SIZE + MIN_RECORD_SIZE || end > self->map_size)
+	{
+		return NULL;
+	}
+
+	uint32_t size;
+	memcpy (&size, self->map + end - sizeof (size), sizeof (size));
+	if (size < MIN_RECORD_SIZE || size % RECORD_ALIGNMENT
+		|| size > end - HISTORY_STORE_HEADER_SIZE)
+	{
+		return NULL;
+	}
+
+	const history_record_t *record = (const history_record_t *) (self->map + end - size);
+	if (record->size != size || RECORD_SIZE (record->length) != size
+		|| '\0' != record->text[record->length])
+	{
+		return NULL;
+	}
+
+	return record;
+}
+
+/**
+ * Appends to "records" the most recent occurrence of the "n" most recent
+ * distinct command lines, from the most recent one, as long as their total
+ * size does not exceed "max_size". Returns their total size.
+ */
+static size_t
+history_store_collect (HistoryStore *self, size_t n, size_t max_size,
+	Array *records)
+{
+	// Open addressing hash set of the records already collected.
+	size_t capacity = 64;
+	size_t count = 0;
+	const history_record_t **seen = calloc (capacity, sizeof (*seen));
+	assert (seen);
+
+	size_t total_size = 0;
+	for (const history_record_t *record = history_store_get_record_before (self,
+			self->map_size);
+		record && count < n;
+		record = history_store_get_previous (self, record))
+	{
+		size_t i = record->hash & (capacity - 1);
+		for (; seen[i]; i = (i + 1) & (capacity - 1))
+		{
+			if (seen[i]->hash == record->hash && seen[i]->length == record->length
+				&& 0 == memcmp (seen[i]->text, record->text, record->length))
+			{
+				break;
+			}
+		}
+		if (seen[i]) // There is a more recent occurrence.
+		{
+			continue;
+		}
+		if (total_size + record->size > max_size)
+		{
+			break;
+		}
+
+		seen[i] = record;
+		array_append (records, (void *) record);
+		total_size += record->size;
+
+		if (++count > capacity / 2)
+		{
+			size_t new_capacity = capacity * 2;
+			const history_record_t **new_seen = calloc (new_capacity,
+				sizeof (*new_seen));
+			assert (new_seen);
+			for (size_t j = 0; j < capacity; ++j)
+			{
+				if (seen[j])
+				{
+					size_t k = seen[j]->hash & (new_capacity - 1);
+					while (new_seen[k])
+					{
+						k = (k + 1) & (new_capacity - 1);
+					}
+					new_seen[k] = seen[j];
+				}
+			}
+			free (seen);
+			seen = new_seen;
+			capacity = new_capacity;
+		}
+	}
+
+	free (seen);
+
+	return total_size;
+}
+
+/**
+ * Writes in "buffer" the record of a command line and returns its size.
+ */
+static size_t
+history_store_write_record (char *buffer, const char *line, size_t length,
+	time_t time, uint32_t session, uint32_t sequence)
+{
+	uint32_t size = (uint32_t) RECORD_SIZE (length);
+
+	history_record_t *record = (history_record_t *) buffer;
+	record->size = size;
+	record->length = (uint32_t) length;
+	record->hash = string_hash (line);
+	record->time = time;
+	record->session = session;
+	record->sequence = sequence;
+	memcpy (record->text, line, length);
+	memset (record->text + length, '\0',
+		size - sizeof (history_record_t) - length - sizeof (size));
+	memcpy (buffer + size - sizeof (size), &size, sizeof (size));
+
+	return size;
+}
+
+static void
+history_store_real_finalize (void *self)
+{
+	assert (self);
+
+	history_store_close (self);
+	free (HISTORY_STORE (self)->path);
+
+	assert (klass);
+	object_class_get_parent (klass)->finalize (self);
+}
+
+static void
+history_store_class_real_finalize (void *_klass)
+{
+	assert (_klass == klass);
+	klass = NULL;
+}
@@ -0,0 +1,406 @@
+/**
+ * This file is a part of Shelldon.
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef HISTORY_STORE_H
+#define HISTORY_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "array.h"
+#include "assert.h"
+#include "object.h"
+
+typedef struct HistoryStore HistoryStore;
+typedef struct HistoryStoreClass HistoryStoreClass;
+
+#define HISTORY_STORE(pointer) ((HistoryStore *) pointer)
+
+#define HISTORY_STORE_CLASS(pointer) ((HistoryStoreClass *) pointer)
+
+/**
+ * The first bytes of a history store file.
+ */
+#define HISTORY_STORE_MAGIC "SHDNHST2"
+
+/**
+ * The size of the header of a history store file (the magic string, without
+ * its '\0').
+ */
+#define HISTORY_STORE_HEADER_SIZE (sizeof (HISTORY_STORE_MAGIC) - 1)
+
+/**
+ * Represents the HistoryStore class or a HistoryStore-based class.
+ */
+struct HistoryStoreClass {
+	ObjectClass parent;
+};
+
+/**
+ * Allocates and initializes a new HistoryStore-based class of size "size" with
+ * name "name".
+ *
+ * This function is only useful to create a HistoryStore-based class.
+ *
+ * @param size   The size of the structure of the class to allocate (must be
+ *               greater or equal to "sizeof (HistoryStoreClass)".
+ * @param parent An owned reference to the parent class.
+ * @param name   The name of the class (must not be NULL).
+ *
+ * @return The new allocated memory with all fields filled.
+ */
+HistoryStoreClass *
+history_store_class_allocate (size_t size, void *parent, char *name);
+
+/**
+ * Returns an owned reference the HistoryStore class.
+ *
+ * When no longer needed, the reference should be unreferenced by calling
+ * "object_class_unref (void *)".
+ *
+ * This function is only useful to create a HistoryStore-based class.
+ *
+ * @return The reference.
+ */
+HistoryStoreClass *
+history_store_class_get (void);
+
+/**
+ * A record of a history store file, as it is stored.
+ *
+ * The records are aligned on 8 bytes. The last 4 bytes of a record hold a copy
+ * of @size so that the file can be read from its end.
+ */
+typedef struct
+{
+	/**
+	 * The size of the whole record (a multiple of 8).
+	 */
+	uint32_t size;
+
+	/**
+	 * The length of @text.
+	 */
+	uint32_t length;
+
+	/**
+	 * The hash of @text (see string_hash ()).
+	 */
+	uint64_t hash;
+
+	/**
+	 * When the command line was entered, or 0 if it is unknown.
+	 */
+	int64_t time;
+
+	/**
+	 * The HistoryStore which has appended the record (see @session of
+	 * HistoryStore), or 0 if it is unknown.
+	 */
+	uint32_t session;
+
+	/**
+	 * The number of the record among the ones appended by its session, from 1.
+	 */
+	uint32_t sequence;
+
+	/**
+	 * The command line ('\0' terminated).
+	 */
+	char text[];
+} history_record_t;
+
+/**
+ * Represents an instance of the HistoryStore type.
+ *
+ * It stores the command lines entered in a binary file which is read through
+ * a memory mapping, so that reading the history does not depend on its size:
+ * only the records which are used are read, from the most recent one.
+ *
+ * The records are only appended to the file, with a single write each so that
+ * several shells can share it without locking it. Each HistoryStore numbers
+ * the records it appends, so that a shell can tell the records of the other
+ * shells from its own ones, and can find again the last one it knows after the
+ * file has been replaced. Older records and duplicates are removed by
+ * history_store_compact ().
+ */
+struct HistoryStore {
+	Object parent;
+
+	/**
+	 * The path of the file.
+	 */
+	char *path;
+
+	/**
+	 * The file descriptor used to append the records, or -1 if the file is not
+	 * opened.
+	 */
+	int fd;
+
+	/**
+	 * The mapping of the file, or NULL.
+	 */
+	const char *map;
+
+	/**
+	 * The size of @map.
+	 */
+	size_t map_size;
+
+	/**
+	 * The size of the file when it was last read or written.
+	 */
+	size_t size;
+
+	/**
+	 * The device and the inode of the opened file, which tell whether the file
+	 * has been replaced.
+	 */
+	dev_t device;
+	ino_t inode;
+
+	/**
+	 * The modification time of the file when it was last read or written.
+	 */
+	struct timespec mtime;
+
+	/**
+	 * The offset following the last record known: the records following it
+	 * are returned by history_store_read_new ().
+	 */
+	size_t position;
+
+	/**
+	 * The session and the sequence number of the last record known, or 0.
+	 */
+	uint32_t last_session;
+	uint32_t last_sequence;
+
+	/**
+	 * The time of the last record known.
+	 */
+	int64_t last_time;
+
+	/**
+	 * The random number identifying the records appended by this HistoryStore.
+	 */
+	uint32_t session;
+
+	/**
+	 * The sequence number of the last record appended by this HistoryStore.
+	 */
+	uint32_t sequence;
+};
+
+/**
+ * Allocates a memory space of size "size" and initializes the HistoryStore
+ * instance. The file is not opened before it is used.
+ *
+ * @param size  The memory space to allocate (greater or equal to
+ *              "sizeof (HistoryStore)").
+ * @param klass An owned reference to the class of this object (must not be
+ *              NULL).
+ * @param path  The path of the file (must not be NULL).
+ *
+ * @return An owned reference to the newly allocated HistoryStore.
+ */
+HistoryStore *
+history_store_construct (size_t size, void *klass, const char *path);
+
+/**
+ * Allocates and initializes a new HistoryStore object.
+ *
+ * @param path The path of the file (must not be NULL).
+ *
+ * @return The new HistoryStore.
+ */
+static inline HistoryStore *
+history_store_new (const char *path);
+
+/**
+ * Appends a command line to the file, which is created if needed.
+ *
+ * @param self The HistoryStore.
+ * @param line The command line (must not contain '\n').
+ * @param time When the command line was entered, or 0 if it is unknown.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+history_store_append (void *self, const char *line, time_t time);
+
+/**
+ * Removes all the records.
+ *
+ * @param self The HistoryStore.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+history_store_clear (void *self);
+
+/**
+ * Closes the file. It will be opened again when needed, which is required if
+ * it has been replaced (e.g. by history_store_compact () in another process).
+ *
+ * @param self The HistoryStore.
+ */
+void
+history_store_close (void *self);
+
+/**
+ * Replaces the file by a copy keeping only the most recent occurrence of each
+ * command line, as long as they fit in "max_size" bytes.
+ *
+ * @param self     The HistoryStore.
+ * @param max_size The maximum size of the new file.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+history_store_compact (void *self, size_t max_size);
+
+/**
+ * Writes the command lines to a text file, one per line, from the oldest one.
+ *
+ * @param self The HistoryStore.
+ * @param file The path of the text file.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+history_store_export (void *self, const char *file);
+
+/**
+ * Returns whether the file exists.
+ *
+ * @param self The HistoryStore.
+ *
+ * @return True if the file exists.
+ */
+bool
+history_store_exists (void *self);
+
+/**
+ * Returns the most recent record.
+ *
+ * The records returned by the HistoryStore are only valid until the file is
+ * modified or read again through the HistoryStore.
+ *
+ * @param self The HistoryStore.
+ *
+ * @return The record or NULL if there is none.
+ */
+const history_record_t *
+history_store_get_last (void *self);
+
+/**
+ * Returns the record preceding "record".
+ *
+ * @param self   The HistoryStore.
+ * @param record A record returned by the HistoryStore.
+ *
+ * @return The record or NULL if "record" is the first one.
+ */
+const history_record_t *
+history_store_get_previous (const void *self, const history_record_t *record);
+
+/**
+ * Appends to "records" the records of the "n" most recent distinct command
+ * lines, from the most recent one.
+ *
+ * @param self    The HistoryStore.
+ * @param n       The maximum number of records.
+ * @param records The Array where to append the records.
+ *
+ * @return The number of records appended.
+ */
+size_t
+history_store_get_recent (void *self, size_t n, Array *records);
+
+static inline const char *
+history_store_get_path (const void *self);
+
+/**
+ * Returns the size of the file when it was last read or written through the
+ * HistoryStore.
+ *
+ * @param self The HistoryStore.
+ *
+ * @return The size in bytes.
+ */
+static inline size_t
+history_store_get_size (const void *self);
+
+/**
+ * Appends to "records" the records appended by other HistoryStores since the
+ * file was opened or since the last call, from the oldest one.
+ *
+ * The file is only read if its size or its modification time has changed, so
+ * this function is cheap enough to be called before each command line. If
+ * the file has been replaced (e.g. compacted), the reading starts again after
+ * the last record known.
+ *
+ * @param self    The HistoryStore.
+ * @param records The Array where to append the records.
+ *
+ * @return The number of records appended.
+ */
+size_t
+history_store_read_new (void *self, Array *records);
+
+/**
+ * Appends the lines of a text file, such as the ones written by readline, as
+ * command lines of unknown time. The lines starting with '#' (timestamps) and
+ * the empty ones are skipped.
+ *
+ * @param self The HistoryStore.
+ * @param file The path of the text file.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+history_store_import (void *self, const char *file);
+
+
+// Inline functions:
+
+static inline HistoryStore *
+history_store_new (const char *path)
+{
+	return history_store_construct (sizeof (HistoryStore),
+		history_store_class_get (), path);
+}
+
+static inline const char *
+history_store_get_path (const void *self)
+{
+	assert (self);
+
+	return HISTORY_STORE (self)->path;
+}
+
+static inline size_t
+history_store_get_size (const void *self)
+{
+	assert (self);
+
+	return HISTORY_STORE (self)->size;
+}
+
+#endif
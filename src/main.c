@@ -15,74 +15,235 @@
  * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
  **/
 
+#include <errno.h>
+#include <error.h>
+#include <fcntl.h>
+#include <getopt.h>
 #include <stdbool.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "array.h"
 #include "cmd.h"
 #include "object.h"
+#include "profile.h"
+#include "session.h"
 #include "shell.h"
 #include "version.h"
 
 #include "string.h"
 
-int
-main (void)
+static void
+add_commands (Shell *shell)
 {
-	{
-		// Prevents SIGINT & SIGTSTP from stopping the process.
-		struct sigaction handler;
-		handler.sa_handler = SIG_IGN;
-		handler.sa_flags = 0;
-		sigemptyset (&handler.sa_mask);
-		sigaction (SIGINT, &handler, NULL);
-		sigaction (SIGTSTP, &handler, NULL);
-	}
-
-	Shell *shell = shell_new (get_prog_name ());
-
+	shell_add_command (shell, "bg", cmd_bg, "[JOB]",
+		"Resumes the stopped job JOB (or the most recent one) in background.");
 	shell_add_command (shell, "cd", cmd_cd, "[DIR]",
 		"Changes the current directory to DIR. If DIR is \"-\", tries to move to\n"
 		"the previous one. Finally, if DIR is not specified, tries to move to\n"
 		"your home directory.");
-	shell_add_command (shell, "history", cmd_history, "-c",
-		"Manages the history.");
+	shell_add_command (shell, "fg", cmd_fg, "[JOB]",
+		"Resumes the job JOB (or the most recent one) in foreground.");
+	shell_add_command (shell, "hash", cmd_hash, "[-r] [-p PATH NAME] [NAME...]",
+		"Lists the remembered locations of programs. \"-r\" forgets them all,\n"
+		"\"-p\" sets the location of NAME to PATH and NAMEs are looked up in\n"
+		"PATH and remembered.");
+	shell_add_command (shell, "history", cmd_history,
+		"-c | -r FILE | -w FILE | -s PATTERN",
+		"Manages the history. \"-c\" clears it, \"-r\" adds the lines of FILE to\n"
+		"it, \"-w\" writes it to FILE and \"-s\" prints the command lines which\n"
+		"contain PATTERN.");
 	shell_add_command (shell, "exec", cmd_exec, "PATH",
 		"Replaces the current shell with the program PATH.");
-	shell_add_command (shell, "execbg", cmd_execbg, "PATH", NULL);
-	shell_add_command (shell, "execfg", cmd_execfg, "PATH", NULL);
+	shell_add_pipeline_command (shell, "execbg", cmd_execbg, "PATH", NULL);
+	shell_add_pipeline_command (shell, "execfg", cmd_execfg, "PATH", NULL);
 	shell_add_command (shell, "exit", cmd_exit, NULL, "Leaves the shell.");
 	shell_add_command (shell, "help", cmd_help, "[COMMAND...]",
 		"Lists the available commands or shows the help message of COMMAND.");
+	shell_add_command (shell, "jobs", cmd_jobs, NULL,
+		"Lists the programs started in background.");
+	shell_add_command (shell, "profile", cmd_profile, "[-r]",
+		"Shows how many times each phase of the shell has run and how long it\n"
+		"took (\"-r\" forgets them), and how many instances of each class have\n"
+		"reused the memory of destroyed ones.");
 	shell_add_command (shell, "pwd", cmd_pwd, NULL,
 		"Shows the current working directory.");
 	shell_add_command (shell, "setenv", cmd_setenv, NULL,
 		"Lists and sets environment variables.");
+	shell_add_command (shell, "stats", cmd_stats, "[-c | -p | -P]",
+		"Shows how many times each command has run and the percentiles of its\n"
+		"durations. \"-c\" forgets them, \"-p\" keeps them across sessions\n"
+		"and \"-P\" stops keeping them.");
+	shell_add_pipeline_command (shell, "time", cmd_time, "[-t MS | COMMAND...]",
+		"Executes COMMAND and shows the time and the memory used by its programs\n"
+		"(or the ones of the last command line which has run programs). \"-t\"\n"
+		"shows them after each command line lasting MS milliseconds or more (-1\n"
+		"to stop).");
 	shell_add_command (shell, "version", cmd_version, "[-n|-v]",
 		"Shows the version of Shelldon.");
 	shell_add_command (shell, "sdc", cmd_sdc, "COMMAND", NULL);
+	shell_add_command (shell, "wait", cmd_wait, "[JOB]",
+		"Waits for the job JOB or for all the running jobs.");
+}
+
+static void
+print_usage (const char *name)
+{
+	fprintf (stderr, "Usage: %s [--profile-startup] [--record SESSION]"
+		" [-c COMMAND_LINES | FILE]\n"
+		"       %s [--profile-startup] [--fast] --replay SESSION\n", name, name);
+}
+
+int
+main (int argc, char **argv)
+{
+	profile_start ();
+
+	static const struct option long_options[] = {
+		{ "fast", no_argument, NULL, 'F' },
+		{ "profile-startup", no_argument, NULL, 'P' },
+		{ "record", required_argument, NULL, 'R' },
+		{ "replay", required_argument, NULL, 'S' },
+		{ NULL, 0, NULL, 0 }
+	};
+
+	const char *command_lines = NULL;
+	const char *record = NULL;
+	const char *replay = NULL;
+	bool paced = true;
+	int opt;
+	while (-1 != (opt = getopt_long (argc, argv, "+c:", long_options, NULL)))
+	{
+		if ('c' == opt)
+		{
+			command_lines = optarg;
+		}
+		else if ('F' == opt)
+		{
+			paced = false;
+		}
+		else if ('P' == opt)
+		{
+			profile_set_startup_report (true);
+		}
+		else if ('R' == opt)
+		{
+			record = optarg;
+		}
+		else if ('S' == opt)
+		{
+			replay = optarg;
+		}
+		else
+		{
+			print_usage (argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	const char *file = (optind < argc ? argv[optind] : NULL);
+	if (replay && (command_lines || file || record))
+	{
+		print_usage (argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// Neither readline nor the history are used if we are not interactive.
+	bool interactive = !command_lines && !file && !replay
+		&& isatty (STDIN_FILENO);
+
+	if (interactive)
+	{
+		// Prevents SIGINT & SIGTSTP from stopping the process.
+		struct sigaction handler;
+		handler.sa_handler = SIG_IGN;
+		handler.sa_flags = 0;
+		sigemptyset (&handler.sa_mask);
+		sigaction (SIGINT, &handler, NULL);
+		sigaction (SIGTSTP, &handler, NULL);
+	}
+
+	Shell *shell = shell_new (get_prog_name ());
+	shell_set_interactive (shell, interactive);
+	add_commands (shell);
 
 /*	print_version ();*/
 
-	while (!shell_is_done (shell))
+	if (record && -1 == session_start_recording (record))
+	{
+		error (0, errno, "%s", record);
+		object_unref (shell);
+		return EXIT_FAILURE;
+	}
+
+	int status = 0;
+	if (!interactive) // There is no prompt, the shell is ready to run commands.
 	{
-		Array *cl;
-		if ( (cl = shell_get_command_line (shell)) ) // The command line is not empty.
+		profile_report_startup ();
+	}
+	if (replay)
+	{
+		if (-1 == session_replay (shell, replay, paced, &status))
 		{
-			if (shell_execute_command_line (shell, cl, NULL) == -1)
+			error (0, errno, "%s", replay);
+			status = -1;
+		}
+	}
+	else if (command_lines)
+	{
+		shell_execute_string (shell, command_lines, &status);
+	}
+	else if (file)
+	{
+		int fd = open (file, O_RDONLY | O_CLOEXEC);
+		if (-1 == fd)
+		{
+			error (0, errno, "%s", file);
+			object_unref (shell);
+			return EXIT_FAILURE;
+		}
+		if (-1 == shell_execute_fd (shell, fd, &status))
+		{
+			error (0, errno, "%s", file);
+			status = -1;
+		}
+		close (fd);
+	}
+	else if (!interactive)
+	{
+		if (-1 == shell_execute_fd (shell, STDIN_FILENO, &status))
+		{
+			error (0, errno, "stdin");
+			status = -1;
+		}
+	}
+	else
+	{
+		while (!shell_is_done (shell))
+		{
+			shell_update_jobs (shell);
+
+			CommandLine *cl;
+			if ( (cl = shell_get_command_line (shell)) ) // The command line is not empty.
 			{
-				fprintf (stderr, "Unable to execute your last command.\n");
+				if (shell_execute_command_line (shell, cl, NULL) == -1)
+				{
+					fprintf (stderr, "Unable to execute your last command.\n");
+				}
+				object_unref (cl);
 			}
-			object_unref (cl);
 		}
-	}
 
-	printf ("Bye.\n");
+		printf ("Bye.\n");
+	}
 
+	session_stop_recording ();
+	if (-1 == shell_save_command_stats (shell, false))
+	{
+		error (0, errno, "stats");
+	}
 	object_unref (shell);
 
-	return EXIT_SUCCESS;
+	return (status ? EXIT_FAILURE : EXIT_SUCCESS);
 }
-
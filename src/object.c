@@ -19,6 +19,11 @@ object_class_real_finalize (void *klass);
 
 static ObjectClass *klass = NULL;
 
+/**
+ * The classes which have not been freed, linked by their "next" field.
+ */
+static ObjectClass *classes = NULL;
+
 ObjectClass *
 object_class_allocate (size_t size, void *parent, char *name)
 {
@@ -39,6 +44,15 @@ object_class_allocate (size_t size, void *parent, char *name)
 	object_class->to_string = object_real_to_string;
 	object_class->finalize = object_real_finalize;
 	object_class->finalize_class = NULL;
+	object_class->free_list = NULL;
+	object_class->instance_size = 0;
+	object_class->free_count = 0;
+	object_class->free_max = OBJECT_CLASS_DEFAULT_FREE_MAX;
+	object_class->n_constructed = 0;
+	object_class->n_reused = 0;
+
+	object_class->next = classes;
+	classes = object_class;
 
 	return object_class;
 }
@@ -55,6 +69,17 @@ object_class_get (void)
 	return object_class_ref (klass);
 }
 
+void
+object_class_foreach (object_class_func_t function, void *data)
+{
+	assert (function);
+
+	for (const ObjectClass *p = classes; p; p = p->next)
+	{
+		function (p, data);
+	}
+}
+
 bool
 object_class_is_a (const void *klass, const void *name)
 {
@@ -74,6 +99,24 @@ object_class_is_a (const void *klass, const void *name)
 	return false;
 }
 
+void
+object_class_set_free_max (void *klass, unsigned int free_max)
+{
+	assert (klass);
+
+	OBJECT_CLASS (klass)->free_max = free_max;
+
+	// Releases the blocks over the new limit.
+	while (OBJECT_CLASS (klass)->free_count > free_max)
+	{
+		void *block = OBJECT_CLASS (klass)->free_list;
+		OBJECT_CLASS (klass)->free_list = *(void **) block;
+		--(OBJECT_CLASS (klass)->free_count);
+
+		free (block);
+	}
+}
+
 void
 object_class_unref (void *klass)
 {
@@ -82,10 +125,21 @@ object_class_unref (void *klass)
 
 	--(OBJECT_CLASS (klass)->ref_count);
 
-	if (OBJECT_CLASS (klass)->ref_count == 0)
+	// A class which reuses memory is kept with its free list and its counters,
+	// otherwise a lone temporary instance would never find a block to reuse.
+	if (OBJECT_CLASS (klass)->ref_count == 0 && !OBJECT_CLASS (klass)->free_max)
 	{
 		debug ("Class deletion: %s", object_class_get_name (klass));
 
+		assert (!OBJECT_CLASS (klass)->free_list);
+
+		ObjectClass **p = &classes;
+		while (*p != klass)
+		{
+			p = &(*p)->next;
+		}
+		*p = OBJECT_CLASS (klass)->next;
+
 		if (OBJECT_CLASS (klass)->finalize_class)
 		{
 			OBJECT_CLASS (klass)->finalize_class (klass);
@@ -108,14 +162,35 @@ object_construct (size_t size, void *klass)
 
 	debug ("Instance creation: %s", object_class_get_name (klass));
 
-	Object *self = malloc (size);
-	if (!self) // Allocation failed.
+	ObjectClass *object_class = OBJECT_CLASS (klass);
+
+	Object *self;
+	if (object_class->free_list && size == object_class->instance_size)
 	{
-		return NULL;
+		self = object_class->free_list;
+		object_class->free_list = *(void **) self;
+		--(object_class->free_count);
+
+		++(object_class->n_reused);
 	}
+	else
+	{
+		self = malloc (size);
+		if (!self) // Allocation failed.
+		{
+			return NULL;
+		}
+
+		if (!object_class->instance_size)
+		{
+			object_class->instance_size = size;
+		}
+	}
+	++(object_class->n_constructed);
 
 	self->ref_count = 1;
 	self->klass = klass;
+	self->size = size;
 
 	return self;
 }
@@ -130,11 +205,27 @@ object_unref (void *self)
 
 	if (OBJECT (self)->ref_count == 0)
 	{
-		assert (object_get_class (self)->finalize);
+		ObjectClass *klass = object_get_class (self);
+
+		assert (klass->finalize);
+
+		klass->finalize (self);
 
-		object_get_class (self)->finalize (self);
+		// The memory is kept for the next instance of this class if possible.
+		if (OBJECT (self)->size == klass->instance_size
+			&& klass->free_count < klass->free_max)
+		{
+			*(void **) self = klass->free_list;
+			klass->free_list = self;
+			++(klass->free_count);
+		}
+		else
+		{
+			free (self);
+		}
 
-		free (self);
+		// Done last because the class may be deallocated.
+		object_class_unref (klass);
 	}
 }
 
@@ -153,8 +244,9 @@ object_real_to_string (const void *self)
 static void
 object_real_finalize (void *self)
 {
+	// The class is unreferenced by object_unref () once the memory of the
+	// instance has been released.
 	debug ("Instance deletion: %s", object_get_class_name (self));
-	object_class_unref (object_get_class (self));
 }
 
 static void
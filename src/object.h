@@ -78,8 +78,55 @@ struct ObjectClass {
 	 * Contrary to the previous one, you should not call the parent method.
 	 */
 	void (*finalize_class) (void *);
+
+	/**
+	 * The memory of destroyed instances, kept to be reused by the next ones
+	 * (each block starts with a pointer to the next one).
+	 */
+	void *free_list;
+
+	/**
+	 * The size of the instances of this class (set by the first
+	 * construction). Only the instances of this size are kept in @free_list.
+	 */
+	size_t instance_size;
+
+	/**
+	 * The number of blocks in @free_list.
+	 */
+	unsigned int free_count;
+
+	/**
+	 * The maximum number of blocks in @free_list (0 disables it).
+	 */
+	unsigned int free_max;
+
+	/**
+	 * The number of instances constructed.
+	 */
+	unsigned long n_constructed;
+
+	/**
+	 * The number of instances constructed with a block of @free_list.
+	 */
+	unsigned long n_reused;
+
+	/**
+	 * The class allocated before this one (see object_class_foreach ()).
+	 */
+	ObjectClass *next;
 };
 
+/**
+ * A function of this type is called for each class by object_class_foreach ().
+ */
+typedef void (*object_class_func_t) (const ObjectClass *klass, void *data);
+
+/**
+ * The default maximum number of blocks kept for reuse by a class.
+ */
+#define OBJECT_CLASS_DEFAULT_FREE_MAX 64
+
 /**
  * Allocates and initializes a new Object-based class of size "size" with name
  * "name".
@@ -129,6 +176,37 @@ object_class_get_name (const void *klass);
 static inline ObjectClass *
 object_class_get_parent (const void *klass);
 
+/**
+ * Returns the number of instances of the class which have been constructed.
+ *
+ * @param klass The class (must not be NULL).
+ *
+ * @return The number of instances.
+ */
+static inline unsigned long
+object_class_get_n_constructed (const void *klass);
+
+/**
+ * Returns the number of instances of the class which have been constructed
+ * with the memory of a previously destroyed one.
+ *
+ * @param klass The class (must not be NULL).
+ *
+ * @return The number of instances.
+ */
+static inline unsigned long
+object_class_get_n_reused (const void *klass);
+
+/**
+ * Calls "function" for each class which has been allocated and not freed yet,
+ * from the most recent one, e.g. to show how often they reuse memory.
+ *
+ * @param function The function (must not be NULL).
+ * @param data     The second argument of "function".
+ */
+void
+object_class_foreach (object_class_func_t function, void *data);
+
 /**
  * Returns true if "klass" is a reference to the class called "name" or a
  * subclass of it.
@@ -152,8 +230,21 @@ static inline void *
 object_class_ref (void *klass);
 
 /**
- * Unregisters a reference of this class. If there is no references left, the
- * class is freed.
+ * Sets the maximum number of blocks of destroyed instances the class keeps for
+ * its next instances. A class with a maximum of 0 is freed with its last
+ * reference.
+ *
+ * @param klass    The class (must not be NULL).
+ * @param free_max The maximum number of blocks (0 disables the reuse).
+ */
+void
+object_class_set_free_max (void *klass, unsigned int free_max);
+
+/**
+ * Unregisters a reference of this class. If there is no references left and
+ * the class does not reuse the memory of its instances (see
+ * object_class_set_free_max ()), the class is freed. Otherwise it is kept, with
+ * its free list and its counters, until the process exits.
  *
  * @param klass The class (must not be NULL).
  */
@@ -174,6 +265,11 @@ struct Object {
 	 * When it reaches zero, the object is automatically deallocated.
 	 */
 	unsigned int ref_count;
+
+	/**
+	 * The size of the memory space of this object.
+	 */
+	unsigned int size;
 };
 
 /**
@@ -267,6 +363,22 @@ object_class_get_name (const void *klass)
 	return OBJECT_CLASS (klass)->name;
 }
 
+static inline unsigned long
+object_class_get_n_constructed (const void *klass)
+{
+	assert (klass);
+
+	return OBJECT_CLASS (klass)->n_constructed;
+}
+
+static inline unsigned long
+object_class_get_n_reused (const void *klass)
+{
+	assert (klass);
+
+	return OBJECT_CLASS (klass)->n_reused;
+}
+
 static inline ObjectClass *
 object_class_get_parent (const void *klass)
 {
@@ -279,8 +391,8 @@ static inline void *
 object_class_ref (void *klass)
 {
 	assert (klass);
-	assert (OBJECT_CLASS (klass)->ref_count);
 
+	// The count may be 0 if the class has been kept (see object_class_unref ()).
 	++(OBJECT_CLASS (klass)->ref_count);
 
 	return klass;
@@ -0,0 +1,451 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include "path_cache.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "debug.h"
+#include "object.h"
+#include "string.h"
+
+#define INITIAL_CAPACITY 32
+
+/**
+ * The search path used by execvp () when PATH is not set.
+ */
+#define DEFAULT_PATH "/bin:/usr/bin"
+
+static void
+path_cache_free_dirs (PathCache *self);
+
+static path_cache_entry_t *
+path_cache_insert (PathCache *self, const char *name, size_t hash,
+	const char *path, size_t dir_index);
+
+static void
+path_cache_read_mtimes (PathCache *self);
+
+static bool
+path_cache_dirs_unchanged (PathCache *self, size_t n);
+
+static void
+path_cache_update_dirs (PathCache *self);
+
+static void
+path_cache_real_finalize (void *);
+
+static void
+path_cache_class_real_finalize (void *);
+
+static PathCacheClass *klass = NULL;
+
+PathCacheClass *
+path_cache_class_allocate (size_t size, void *parent, char *name)
+{
+	assert (name);
+	assert_cmpuint (size, >=, sizeof (PathCacheClass));
+
+	PathCacheClass *path_cache_class = PATH_CACHE_CLASS (object_class_allocate (size, parent, name));
+	if (!path_cache_class) // Allocation failed
+	{
+		return NULL;
+	}
+
+	OBJECT_CLASS (path_cache_class)->finalize = path_cache_real_finalize;
+
+	return path_cache_class;
+}
+
+PathCacheClass *
+path_cache_class_get (void)
+{
+	if (!klass) // The PathCache class is not yet initalized.
+	{
+		klass = path_cache_class_allocate (sizeof (PathCacheClass), object_class_get (), "PathCache");
+		OBJECT_CLASS (klass)->finalize_class = path_cache_class_real_finalize;
+		return klass;
+	}
+
+	return object_class_ref (klass);
+}
+
+PathCache *
+path_cache_construct (size_t size, void *klass)
+{
+	assert_cmpuint (size, >=, sizeof (PathCache));
+
+	PathCache *self = PATH_CACHE (object_construct (size, klass));
+
+	self->path_env = NULL;
+	self->dirs = NULL;
+	self->mtimes = NULL;
+	self->n_dirs = 0;
+	self->first_relative_dir = 0;
+	self->table = NULL;
+	self->capacity = 0;
+	self->size = 0;
+
+	return self;
+}
+
+void
+path_cache_clear (void *self)
+{
+	assert (self);
+
+	for (size_t i = 0; i < PATH_CACHE (self)->capacity; ++i)
+	{
+		path_cache_entry_t *entry = PATH_CACHE (self)->table[i];
+		if (entry)
+		{
+			free (entry->name);
+			free (entry->path);
+			free (entry);
+
+			PATH_CACHE (self)->table[i] = NULL;
+		}
+	}
+
+	PATH_CACHE (self)->size = 0;
+}
+
+void
+path_cache_foreach (const void *self, path_cache_func_t func, void *data)
+{
+	assert (self);
+	assert (func);
+
+	for (size_t i = 0; i < PATH_CACHE (self)->capacity; ++i)
+	{
+		if (PATH_CACHE (self)->table[i])
+		{
+			func (PATH_CACHE (self)->table[i], data);
+		}
+	}
+}
+
+const char *
+path_cache_lookup (void *self, const char *name)
+{
+	assert (self);
+	assert (name);
+
+	if (strchr (name, '/')) // Not searched in PATH.
+	{
+		return name;
+	}
+
+	PathCache *cache = PATH_CACHE (self);
+
+	path_cache_update_dirs (cache);
+
+	size_t hash = string_hash (name);
+	if (cache->capacity)
+	{
+		for (
+			size_t i = hash & (cache->capacity - 1);
+			cache->table[i];
+			i = (i + 1) & (cache->capacity - 1)
+		)
+		{
+			path_cache_entry_t *entry = cache->table[i];
+			if (entry->hash != hash || strcmp (entry->name, name))
+			{
+				continue;
+			}
+
+			if (PATH_CACHE_PINNED == entry->dir_index
+				|| path_cache_dirs_unchanged (cache, (entry->path
+					? entry->dir_index + 1
+					: entry->dir_index)))
+			{
+				++(entry->hits);
+				return entry->path;
+			}
+
+			// A directory has been modified, everything has to be checked again.
+			debug ("PATH directory modified, flushing the path cache");
+			path_cache_clear (cache);
+			path_cache_read_mtimes (cache);
+			break;
+		}
+	}
+
+	String *path = string_new ();
+	for (size_t i = 0; i < cache->first_relative_dir; ++i)
+	{
+		string_clear (path);
+		string_append (path, cache->dirs[i]);
+		string_append_char (path, '/');
+		string_append (path, name);
+
+		struct stat st;
+		if (0 == stat (string_get_chars (path), &st) && S_ISREG (st.st_mode)
+			&& 0 == access (string_get_chars (path), X_OK))
+		{
+			path_cache_entry_t *entry = path_cache_insert (cache, name, hash,
+				string_get_chars (path), i);
+			object_unref (path);
+
+			++(entry->hits);
+			return entry->path;
+		}
+	}
+	object_unref (path);
+
+	if (cache->first_relative_dir != cache->n_dirs)
+	{
+		return name;
+	}
+
+	// Not found, remembers it.
+	path_cache_insert (cache, name, hash, NULL, cache->n_dirs);
+
+	return NULL;
+}
+
+void
+path_cache_set (void *self, const char *name, const char *path)
+{
+	assert (self);
+	assert (name);
+	assert (path);
+
+	path_cache_update_dirs (PATH_CACHE (self));
+	path_cache_insert (PATH_CACHE (self), name, string_hash (name), path,
+		PATH_CACHE_PINNED);
+}
+
+static void
+path_cache_free_dirs (PathCache *self)
+{
+	for (size_t i = 0; i < self->n_dirs; ++i)
+	{
+		free (self->dirs[i]);
+	}
+	free (self->dirs);
+	free (self->mtimes);
+	free (self->path_env);
+
+	self->path_env = NULL;
+	self->dirs = NULL;
+	self->mtimes = NULL;
+	self->n_dirs = 0;
+	self->first_relative_dir = 0;
+}
+
+/**
+ * Inserts or replaces the entry "name" and returns it.
+ */
+static path_cache_entry_t *
+path_cache_insert (PathCache *self, const char *name, size_t hash,
+	const char *path, size_t dir_index)
+{
+	// Keeps the load factor of the table under 1/2.
+	if ( ((self->size + 1) << 1) > self->capacity )
+	{
+		size_t capacity = (self->capacity ? self->capacity << 1 : INITIAL_CAPACITY);
+
+		path_cache_entry_t **table = calloc (capacity, sizeof (path_cache_entry_t *));
+		assert (table);
+
+		for (size_t i = 0; i < self->capacity; ++i)
+		{
+			path_cache_entry_t *entry = self->table[i];
+			if (entry)
+			{
+				size_t j = entry->hash & (capacity - 1);
+				while (table[j])
+				{
+					j = (j + 1) & (capacity - 1);
+				}
+				table[j] = entry;
+			}
+		}
+		free (self->table);
+
+		self->table = table;
+		self->capacity = capacity;
+	}
+
+	size_t i = hash & (self->capacity - 1);
+	for (; self->table[i]; i = (i + 1) & (self->capacity - 1))
+	{
+		path_cache_entry_t *entry = self->table[i];
+		if (entry->hash == hash && !strcmp (entry->name, name))
+		{
+			free (entry->path);
+			entry->path = (path ? strdup (path) : NULL);
+			entry->dir_index = dir_index;
+			return entry;
+		}
+	}
+
+	path_cache_entry_t *entry = malloc (sizeof (path_cache_entry_t));
+	assert (entry);
+
+	entry->name = strdup (name);
+	entry->path = (path ? strdup (path) : NULL);
+	entry->hash = hash;
+	entry->hits = 0;
+	entry->dir_index = dir_index;
+
+	self->table[i] = entry;
+	++(self->size);
+
+	return entry;
+}
+
+/**
+ * Gets the current modification time of each directory.
+ */
+static void
+path_cache_read_mtimes (PathCache *self)
+{
+	for (size_t i = 0; i < self->n_dirs; ++i)
+	{
+		struct stat st;
+		if (0 == stat (self->dirs[i], &st))
+		{
+			self->mtimes[i] = st.st_mtim;
+		}
+		else // Inexistent directory.
+		{
+			self->mtimes[i].tv_sec = 0;
+			self->mtimes[i].tv_nsec = 0;
+		}
+	}
+}
+
+/**
+ * Returns true if none of the "n" first directories has been modified since
+ * their modification times were read.
+ */
+static bool
+path_cache_dirs_unchanged (PathCache *self, size_t n)
+{
+	assert_cmpuint (n, <=, self->n_dirs);
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		struct stat st;
+		if (0 != stat (self->dirs[i], &st))
+		{
+			st.st_mtim.tv_sec = 0;
+			st.st_mtim.tv_nsec = 0;
+		}
+
+		if (st.st_mtim.tv_sec != self->mtimes[i].tv_sec
+			|| st.st_mtim.tv_nsec != self->mtimes[i].tv_nsec)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * If PATH has changed, flushes the cache and splits the new PATH.
+ */
+static void
+path_cache_update_dirs (PathCache *self)
+{
+	const char *path_env = getenv ("PATH");
+	if (!path_env)
+	{
+		path_env = DEFAULT_PATH;
+	}
+
+	if (self->path_env && 0 == strcmp (self->path_env, path_env))
+	{
+		return;
+	}
+
+	debug ("PATH changed, flushing the path cache");
+
+	path_cache_clear (self);
+	path_cache_free_dirs (self);
+
+	self->path_env = strdup (path_env);
+
+	size_t n = 1;
+	for (const char *p = path_env; *p; ++p)
+	{
+		if (':' == *p)
+		{
+			++n;
+		}
+	}
+
+	self->dirs = malloc (sizeof (char *) * n);
+	self->mtimes = malloc (sizeof (struct timespec) * n);
+	assert (self->dirs && self->mtimes);
+
+	const char *p = path_env;
+	for (size_t i = 0; i < n; ++i)
+	{
+		const char *end = strchr (p, ':');
+		if (!end)
+		{
+			end = p + strlen (p);
+		}
+
+		// An empty directory means the current one.
+		self->dirs[i] = (end == p ? strdup (".") : strndup (p, (size_t) (end - p)));
+		p = end + 1;
+	}
+	self->n_dirs = n;
+
+	self->first_relative_dir = n;
+	for (size_t i = 0; i < n; ++i)
+	{
+		if ('/' != self->dirs[i][0])
+		{
+			self->first_relative_dir = i;
+			break;
+		}
+	}
+
+	path_cache_read_mtimes (self);
+}
+
+static void
+path_cache_real_finalize (void *self)
+{
+	assert (self);
+
+	path_cache_clear (self);
+	free (PATH_CACHE (self)->table);
+	path_cache_free_dirs (PATH_CACHE (self));
+
+	assert (klass);
+	object_class_get_parent (klass)->finalize (self);
+}
+
+static void
+path_cache_class_real_finalize (void *_klass)
+{
+	assert (_klass == klass);
+	klass = NULL;
+}
@@ -0,0 +1,268 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "assert.h"
+#include "object.h"
+
+typedef struct PathCache PathCache;
+typedef struct PathCacheClass PathCacheClass;
+
+#define PATH_CACHE(pointer) ((PathCache *) pointer)
+
+#define PATH_CACHE_CLASS(pointer) ((PathCacheClass *) pointer)
+
+/**
+ * Represents the PathCache class or a PathCache-based class.
+ */
+struct PathCacheClass {
+	ObjectClass parent;
+};
+
+/**
+ * Allocates and initializes a new PathCache-based class of size "size" with
+ * name "name".
+ *
+ * This function is only useful to create a PathCache-based class.
+ *
+ * @param size   The size of the structure of the class to allocate (must be
+ *               greater or equal to "sizeof (PathCacheClass)".
+ * @param parent An owned reference to the parent class.
+ * @param name   The name of the class (must not be NULL).
+ *
+ * @return The new allocated memory with all fields filled.
+ */
+PathCacheClass *
+path_cache_class_allocate (size_t size, void *parent, char *name);
+
+/**
+ * Returns an owned reference the PathCache class.
+ *
+ * When no longer needed, the reference should be unreferenced by calling
+ * "object_class_unref (void *)".
+ *
+ * This function is only useful to create a PathCache-based class.
+ *
+ * @return The reference.
+ */
+PathCacheClass *
+path_cache_class_get (void);
+
+/**
+ * An entry of the cache.
+ */
+typedef struct
+{
+	/**
+	 * The name of the program.
+	 */
+	char *name;
+
+	/**
+	 * The absolute path of the program or NULL if it was not found in PATH
+	 * (negative entry).
+	 */
+	char *path;
+
+	/**
+	 * The hash of @name.
+	 */
+	size_t hash;
+
+	/**
+	 * The number of times this entry has been used.
+	 */
+	unsigned int hits;
+
+	/**
+	 * The index of the PATH directory @path was found in, the number of
+	 * directories for a negative entry or PATH_CACHE_PINNED if the entry has
+	 * been set by path_cache_set () and must not be checked.
+	 *
+	 * The entry is valid as long as the directories before this index have not
+	 * been modified.
+	 */
+	size_t dir_index;
+} path_cache_entry_t;
+
+#define PATH_CACHE_PINNED ((size_t) -1)
+
+/**
+ * A function of this type is called for each entry by path_cache_foreach ().
+ */
+typedef void (*path_cache_func_t) (const path_cache_entry_t *entry, void *data);
+
+/**
+ * Represents an instance of the PathCache type.
+ *
+ * It maps program names to their location in the directories of the PATH
+ * environment variable so that PATH does not have to be walked for each
+ * execution.
+ */
+struct PathCache {
+	Object parent;
+
+	/**
+	 * A copy of the PATH the cache has been filled with (may be NULL).
+	 */
+	char *path_env;
+
+	/**
+	 * The directories of @path_env.
+	 */
+	char **dirs;
+
+	/**
+	 * The modification times of @dirs when they were read.
+	 */
+	struct timespec *mtimes;
+
+	/**
+	 * The number of items of @dirs and @mtimes.
+	 */
+	size_t n_dirs;
+
+	/**
+	 * The index of the first relative directory of @dirs or @n_dirs if there
+	 * is none. Since the result of a search in a relative directory depends on
+	 * the current directory, programs are only cached if they are found before
+	 * it.
+	 */
+	size_t first_relative_dir;
+
+	/**
+	 * Open addressing hash table (linear probing) of owned entries.
+	 */
+	path_cache_entry_t **table;
+
+	/**
+	 * The number of slots of @table (0 or a power of 2).
+	 */
+	size_t capacity;
+
+	/**
+	 * The number of entries in @table.
+	 */
+	size_t size;
+};
+
+/**
+ * Allocates a memory space of size "size" and initializes the PathCache
+ * object.
+ *
+ * @param size  The memory space to allocate (greater or equal to
+ *              "sizeof (PathCache)").
+ * @param klass An owned reference to the class of this object (must not be
+ *              NULL).
+ *
+ * @return An owned reference to the newly allocated PathCache.
+ */
+PathCache *
+path_cache_construct (size_t size, void *klass);
+
+/**
+ * Allocates and initializes a new PathCache object.
+ *
+ * @return An owned reference to the newly allocated PathCache or NULL if there
+ *         was an error.
+ */
+static inline PathCache *
+path_cache_new (void);
+
+/**
+ * Removes all the entries of the PathCache.
+ *
+ * @param self The PathCache.
+ */
+void
+path_cache_clear (void *self);
+
+/**
+ * Calls "func" for each entry of the PathCache.
+ *
+ * @param self The PathCache.
+ * @param func The function to call (must not be NULL).
+ * @param data User data passed to "func".
+ */
+void
+path_cache_foreach (const void *self, path_cache_func_t func, void *data);
+
+/**
+ * Returns the number of entries of the PathCache.
+ *
+ * @param self The PathCache.
+ *
+ * @return The number of entries.
+ */
+static inline size_t
+path_cache_get_size (const void *self);
+
+/**
+ * Returns the path of the program "name".
+ *
+ * If "name" contains a '/', it is returned as is. Otherwise, it is searched in
+ * the cache, then in the directories of the PATH environment variable. The
+ * cache is flushed when PATH changes or when one of its directories is
+ * modified.
+ *
+ * If PATH contains a relative directory and "name" is not found before it,
+ * "name" is returned as is and the search is left to execvp ().
+ *
+ * @param self The PathCache.
+ * @param name The name of the program (must not be NULL).
+ *
+ * @return The path of the program or NULL if it was not found. This string
+ *         belongs to the PathCache and is only valid until its next
+ *         modification.
+ */
+const char *
+path_cache_lookup (void *self, const char *name);
+
+/**
+ * Sets the path of the program "name" (the entry will not be checked against
+ * directories modifications).
+ *
+ * @param self The PathCache.
+ * @param name The name of the program (must not be NULL).
+ * @param path The path of the program (must not be NULL).
+ */
+void
+path_cache_set (void *self, const char *name, const char *path);
+
+// Inline functions:
+
+static inline PathCache *
+path_cache_new (void)
+{
+	return path_cache_construct (sizeof (PathCache), path_cache_class_get ());
+}
+
+static inline size_t
+path_cache_get_size (const void *self)
+{
+	assert (self);
+
+	return PATH_CACHE (self)->size;
+}
+
+#endif
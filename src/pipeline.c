@@ -0,0 +1,165 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+// Needed for pipe2 () and F_SETPIPE_SZ.
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pipeline.h"
+
+#include "assert.h"
+#include "profile.h"
+#include "tools.h"
+#include "usage.h"
+
+pid_t
+execute_pipeline (size_t n, const char *const *files, char *const *const *argvs,
+	exec_mode mode, pid_t *pids)
+{
+	assert_cmpuint (n, >, 0);
+	assert (EXEC_REPLACE != mode);
+	assert (pids);
+
+	// Our buffered output must come before the children's one.
+	fflush (stdout);
+
+	bool foreground = (EXEC_FG == mode && isatty (STDIN_FILENO)
+		&& tcgetpgrp (STDIN_FILENO) == getpgrp ());
+
+	uint64_t start = profile_now ();
+	pid_t pgid = 0;
+	int input = -1; // The read end of the previous pipe.
+	int err = 0;
+	size_t started = 0;
+	for (; started < n; ++started)
+	{
+		// All the descriptors are close-on-exec: only the ones duplicated on
+		// the standard input and output of the child will be inherited.
+		int pipe_fds[2] = {-1, -1};
+		if (started + 1 < n)
+		{
+			if (-1 == pipe2 (pipe_fds, O_CLOEXEC))
+			{
+				err = errno;
+				break;
+			}
+#ifdef F_SETPIPE_SZ
+			// It is only a hint: if we are not allowed, the default size is used.
+			fcntl (pipe_fds[1], F_SETPIPE_SZ, PIPELINE_PIPE_SIZE);
+#endif
+		}
+
+		posix_spawn_file_actions_t actions;
+		posix_spawn_file_actions_init (&actions);
+		if (-1 != input)
+		{
+			posix_spawn_file_actions_adddup2 (&actions, input, STDIN_FILENO);
+		}
+		if (-1 != pipe_fds[1])
+		{
+			posix_spawn_file_actions_adddup2 (&actions, pipe_fds[1], STDOUT_FILENO);
+		}
+
+		posix_spawnattr_t attributes;
+		init_spawn_attributes (&attributes, POSIX_SPAWN_SETPGROUP);
+		posix_spawnattr_setpgroup (&attributes, pgid);
+
+		err = spawn_program (pids + started, files[started], &actions,
+			&attributes, argvs[started]);
+
+		posix_spawnattr_destroy (&attributes);
+		posix_spawn_file_actions_destroy (&actions);
+
+		if (-1 != input)
+		{
+			close (input);
+		}
+		if (-1 != pipe_fds[1])
+		{
+			close (pipe_fds[1]);
+		}
+		input = pipe_fds[0];
+
+		if (err)
+		{
+			break;
+		}
+
+		if (!pgid) // First stage, it is the leader of the group.
+		{
+			pgid = pids[0];
+			if (foreground)
+			{
+				give_terminal (pgid);
+
+				// It may have been stopped by SIGTTIN before having the terminal.
+				kill (pids[0], SIGCONT);
+			}
+		}
+	}
+	if (-1 != input)
+	{
+		close (input);
+	}
+	profile_add (PROFILE_SPAWN, start);
+
+	if (err)
+	{
+		// The stages already started end with their output closed.
+		for (size_t i = 0; i < started; ++i)
+		{
+			usage_wait (pids[i], NULL, 0);
+		}
+		if (foreground && pgid)
+		{
+			give_terminal (getpgrp ());
+		}
+
+		errno = err;
+		return -1;
+	}
+	return pgid;
+}
+
+void
+give_terminal (pid_t pgid)
+{
+	if (!isatty (STDIN_FILENO))
+	{
+		return;
+	}
+
+	// SIGTTOU is blocked because we may not be in the foreground group.
+	sigset_t set, old_set;
+	sigemptyset (&set);
+	sigaddset (&set, SIGTTOU);
+	sigprocmask (SIG_BLOCK, &set, &old_set);
+
+	tcsetpgrp (STDIN_FILENO, pgid);
+
+	sigprocmask (SIG_SETMASK, &old_set, NULL);
+}
@@ -0,0 +1,66 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SHELLDON_PIPELINE_H
+#define SHELLDON_PIPELINE_H
+
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "tools.h"
+
+/**
+ * The size requested for the pipes between the stages of a pipeline (the
+ * default one is usually 64 KiB). Bigger pipes mean less context switches for
+ * heavy streams.
+ **/
+#define PIPELINE_PIPE_SIZE (1 << 18)
+
+/**
+ * Executes the "n" programs @files (searched in PATH if not absolute) with
+ * @argvs as arguments, the standard output of each one being connected to the
+ * standard input of the next one.
+ *
+ * All the programs are started in one pass in a new process group. If the
+ * pipeline is run in foreground and the shell controls the terminal, the
+ * terminal is given to this group: the caller waits for the programs, noticing
+ * when they are stopped (e.g. with shell_wait_job ()), then takes the terminal
+ * back.
+ *
+ * @param n     The number of stages (must be greater than 0).
+ * @param files The program names.
+ * @param argvs The NULL-terminated arguments vector of each program.
+ * @param mode  The execution mode (background or foreground).
+ * @param pids  Will contain the pids of the "n" programs (must not be NULL).
+ * @return The process group of the pipeline or -1 (and errno is set) if we
+ *         failed in starting one of the programs, the ones already started
+ *         being waited for.
+ **/
+pid_t
+execute_pipeline (size_t n, const char *const *files, char *const *const *argvs,
+	exec_mode mode, pid_t *pids);
+
+/**
+ * Gives the terminal to the process group "pgid" if the standard input is a
+ * terminal.
+ *
+ * @param pgid The process group.
+ **/
+void
+give_terminal (pid_t pgid);
+
+#endif
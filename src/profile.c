@@ -0,0 +1,147 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "profile.h"
+
+/**
+ * The durations measured for a phase.
+ **/
+typedef struct
+{
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+} profile_stats_t;
+
+static const struct
+{
+	const char *name;
+	unsigned int depth;
+} phases[PROFILE_N_PHASES] = {
+	[PROFILE_CONSTRUCT] = { "construct", 0 },
+	[PROFILE_RESET] = { "reset", 0 },
+	[PROFILE_GET_COMMAND_LINE] = { "get_command_line", 0 },
+	[PROFILE_READLINE_INIT] = { "readline_init", 1 },
+	[PROFILE_HISTORY] = { "history", 1 },
+	[PROFILE_READLINE] = { "readline", 1 },
+	[PROFILE_PARSE] = { "parse", 1 },
+	[PROFILE_EXECUTE_COMMAND_LINE] = { "execute_command_line", 0 },
+	[PROFILE_LOOKUP] = { "lookup", 1 },
+	[PROFILE_PATH_LOOKUP] = { "path_lookup", 1 },
+	[PROFILE_SPAWN] = { "spawn", 1 },
+	[PROFILE_WAIT] = { "wait", 1 },
+};
+
+static profile_stats_t stats[PROFILE_N_PHASES];
+
+static uint64_t start_time = 0;
+
+static bool startup_report = false;
+
+uint64_t
+profile_now (void)
+{
+	struct timespec now;
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+void
+profile_start (void)
+{
+	start_time = profile_now ();
+}
+
+void
+profile_add (profile_phase phase, uint64_t start)
+{
+	uint64_t duration = profile_now () - start;
+
+	profile_stats_t *p = stats + phase;
+	++p->count;
+	p->total += duration;
+	if (duration > p->max)
+	{
+		p->max = duration;
+	}
+}
+
+void
+profile_clear (void)
+{
+	for (int i = 0; i < PROFILE_N_PHASES; ++i)
+	{
+		stats[i].count = stats[i].total = stats[i].max = 0;
+	}
+}
+
+void
+profile_print (FILE *stream)
+{
+	fprintf (stream, "%-24s %8s %12s %12s %12s\n", "phase", "count", "total ms",
+		"mean us", "max us");
+	for (int i = 0; i < PROFILE_N_PHASES; ++i)
+	{
+		const profile_stats_t *p = stats + i;
+		if (!p->count)
+		{
+			// A phase which has not ended yet, or which is skipped (e.g. reading
+			// the lines which are not typed), is shown if its parts have.
+			bool started = false;
+			for (int j = i + 1; !started && j < PROFILE_N_PHASES
+				&& phases[j].depth > phases[i].depth; ++j)
+			{
+				started = (0 != stats[j].count);
+			}
+			if (started)
+			{
+				fprintf (stream, "%*s%-*s %8s %12s %12s %12s\n",
+					2 * phases[i].depth, "", 24 - 2 * phases[i].depth, phases[i].name,
+					"-", "-", "-", "-");
+			}
+			continue;
+		}
+		fprintf (stream, "%*s%-*s %8llu %12.3f %12.1f %12.1f\n",
+			2 * phases[i].depth, "", 24 - 2 * phases[i].depth, phases[i].name,
+			(unsigned long long) p->count, p->total / 1e6,
+			p->total / 1e3 / p->count, p->max / 1e3);
+	}
+}
+
+void
+profile_set_startup_report (bool report)
+{
+	startup_report = report;
+}
+
+void
+profile_report_startup (void)
+{
+	if (!startup_report)
+	{
+		return;
+	}
+	startup_report = false;
+
+	fprintf (stderr, "Startup: %.3f ms\n", (profile_now () - start_time) / 1e6);
+	profile_print (stderr);
+}
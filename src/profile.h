@@ -0,0 +1,103 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SHELLDON_PROFILE_H
+#define SHELLDON_PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * The phases whose durations are measured. A phase which is part of another
+ * one follows it and is indented below it by profile_print ().
+ **/
+typedef enum
+{
+	PROFILE_CONSTRUCT,
+	PROFILE_RESET,
+	PROFILE_GET_COMMAND_LINE,
+	PROFILE_READLINE_INIT,
+	PROFILE_HISTORY,
+	PROFILE_READLINE,
+	PROFILE_PARSE,
+	PROFILE_EXECUTE_COMMAND_LINE,
+	PROFILE_LOOKUP,
+	PROFILE_PATH_LOOKUP,
+	PROFILE_SPAWN,
+	PROFILE_WAIT,
+	PROFILE_N_PHASES
+} profile_phase;
+
+/**
+ * Returns the current time of a monotonic clock.
+ *
+ * @return The time in nanoseconds.
+ **/
+uint64_t
+profile_now (void);
+
+/**
+ * Sets the time from which the startup is measured, i.e. the beginning of the
+ * program.
+ **/
+void
+profile_start (void);
+
+/**
+ * Adds a duration to a phase.
+ *
+ * @param phase The phase.
+ * @param start The beginning of the duration (returned by profile_now ()), which
+ *              ends now.
+ **/
+void
+profile_add (profile_phase phase, uint64_t start);
+
+/**
+ * Forgets all the durations measured.
+ **/
+void
+profile_clear (void);
+
+/**
+ * Prints the number of times each phase has been measured, with their total,
+ * mean and maximum durations.
+ *
+ * @param stream Where to print.
+ **/
+void
+profile_print (FILE *stream);
+
+/**
+ * Asks profile_report_startup () to print the durations of the startup.
+ *
+ * @param report True to print them.
+ **/
+void
+profile_set_startup_report (bool report);
+
+/**
+ * Prints to stderr the time elapsed since profile_start () and the phases
+ * measured so far, if it has been asked with profile_set_startup_report () and
+ * it has not been done yet. It is called when the shell is ready, i.e. before
+ * the first prompt.
+ **/
+void
+profile_report_startup (void);
+
+#endif
@@ -0,0 +1,264 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "assert.h"
+#include "command_line.h"
+#include "object.h"
+#include "profile.h"
+#include "session.h"
+#include "shell.h"
+#include "tools.h"
+
+/**
+ * The number of slowest command lines printed by session_replay ().
+ **/
+#define SESSION_N_SLOWEST 5
+
+/**
+ * A command line replayed and how long it took.
+ **/
+typedef struct
+{
+	uint64_t duration;
+	size_t line;
+	char *text;
+} session_sample_t;
+
+/**
+ * The session file being written, or NULL.
+ **/
+static FILE *stream = NULL;
+
+/**
+ * When the last command line was recorded.
+ **/
+static uint64_t last_time = 0;
+
+/**
+ * The working directory of the last command line recorded.
+ **/
+static char *last_directory = NULL;
+
+static int
+session_compare_samples (const void *a, const void *b);
+
+int
+session_start_recording (const char *path)
+{
+	assert (path);
+
+	session_stop_recording ();
+
+	// The file must not be inherited by the programs executed.
+	stream = fopen (path, "we");
+	if (!stream)
+	{
+		return -1;
+	}
+	setvbuf (stream, NULL, _IOLBF, 0);
+
+	fprintf (stream, SESSION_HEADER " %lld\n", (long long) time (NULL));
+	last_time = profile_now ();
+
+	return 0;
+}
+
+void
+session_record (const char *line)
+{
+	if (!stream)
+	{
+		return;
+	}
+
+	uint64_t now = profile_now ();
+	char *directory = get_cwd ();
+	if (directory && (!last_directory || strcmp (directory, last_directory)))
+	{
+		fprintf (stream, "@%s\n", directory);
+		free (last_directory);
+		last_directory = directory;
+	}
+	else
+	{
+		free (directory);
+	}
+
+	fprintf (stream, "%llu %s\n", (unsigned long long) (now - last_time) / 1000000,
+		line);
+
+	// The delay is rounded down, so the remainder is kept for the next one.
+	last_time = now - (now - last_time) % 1000000;
+}
+
+void
+session_stop_recording (void)
+{
+	if (stream)
+	{
+		fclose (stream);
+		stream = NULL;
+	}
+	free (last_directory);
+	last_directory = NULL;
+}
+
+int
+session_replay (Shell *shell, const char *path, bool paced, int *status)
+{
+	assert (shell);
+	assert (path);
+
+	FILE *file = fopen (path, "re");
+	if (!file)
+	{
+		return -1;
+	}
+
+	session_sample_t *samples = NULL;
+	size_t n = 0;
+	size_t capacity = 0;
+	uint64_t start = profile_now ();
+	uint64_t offset = 0; // When the current command line was recorded.
+	uint64_t total = 0;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t length;
+	for (size_t line_number = 1; !shell_is_done (shell)
+		&& -1 != (length = getline (&line, &size, file)); ++line_number)
+	{
+		if (length && '\n' == line[length - 1])
+		{
+			line[--length] = '\0';
+		}
+		if ('#' == *line || '\0' == *line)
+		{
+			continue;
+		}
+		if ('@' == *line)
+		{
+			char *directory = get_cwd ();
+			if ((!directory || strcmp (directory, line + 1))
+				&& -1 == chdir (line + 1))
+			{
+				fprintf (stderr, "%s:%zu: Failed to change directory to \"%s\".\n",
+					path, line_number, line + 1);
+			}
+			free (directory);
+			continue;
+		}
+
+		char *text;
+		unsigned long long delay = strtoull (line, &text, 10);
+		if (text == line || ' ' != *text)
+		{
+			fprintf (stderr, "%s:%zu: Invalid line.\n", path, line_number);
+			continue;
+		}
+		++text;
+
+		offset += delay * 1000000;
+		if (paced)
+		{
+			uint64_t now = profile_now ();
+			if (now < start + offset)
+			{
+				uint64_t wait = start + offset - now;
+				struct timespec duration = { (time_t) (wait / 1000000000),
+					(long) (wait % 1000000000) };
+				while (-1 == nanosleep (&duration, &duration) && EINTR == errno);
+			}
+		}
+
+		shell_update_jobs (shell);
+		uint64_t command_start = profile_now ();
+		CommandLine *command_line = shell_parse (shell, text);
+		if (!array_is_empty (command_line))
+		{
+			shell_execute_command_line (shell, command_line, status);
+		}
+		object_unref (command_line);
+		uint64_t duration = profile_now () - command_start;
+
+		if (n == capacity)
+		{
+			capacity = (capacity ? capacity * 2 : 64);
+			samples = realloc (samples, capacity * sizeof (session_sample_t));
+			assert (samples);
+		}
+		samples[n].duration = duration;
+		samples[n].line = line_number;
+		samples[n].text = strdup (text);
+		assert (samples[n].text);
+		++n;
+		total += duration;
+	}
+	int error = (ferror (file) ? errno : 0);
+	free (line);
+	fclose (file);
+
+	double elapsed = (double) (profile_now () - start) / 1e9;
+	fprintf (stderr, "Replayed %zu command lines in %.3f s (%.3f s executing"
+		" them).\n", n, elapsed, (double) total / 1e9);
+	if (n)
+	{
+		qsort (samples, n, sizeof (session_sample_t), session_compare_samples);
+		fprintf (stderr, "Latency: median %.3f ms, p90 %.3f ms, p99 %.3f ms,"
+			" max %.3f ms.\n", (double) samples[n / 2].duration / 1e6,
+			(double) samples[n * 90 / 100].duration / 1e6,
+			(double) samples[n * 99 / 100].duration / 1e6,
+			(double) samples[n - 1].duration / 1e6);
+		fprintf (stderr, "Slowest command lines:\n");
+		for (size_t i = n; i > 0 && i + SESSION_N_SLOWEST > n; --i)
+		{
+			fprintf (stderr, "%10.3f ms  %s:%zu: %s\n",
+				(double) samples[i - 1].duration / 1e6, path, samples[i - 1].line,
+				samples[i - 1].text);
+		}
+	}
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		free (samples[i].text);
+	}
+	free (samples);
+
+	if (error)
+	{
+		errno = error;
+		return -1;
+	}
+	return 0;
+}
+
+static int
+session_compare_samples (const void *a, const void *b)
+{
+	uint64_t x = ((const session_sample_t *) a)->duration;
+	uint64_t y = ((const session_sample_t *) b)->duration;
+
+	return (x > y) - (x < y);
+}
@@ -0,0 +1,82 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SHELLDON_SESSION_H
+#define SHELLDON_SESSION_H
+
+#include <stdbool.h>
+
+#include "shell.h"
+
+/**
+ * A session file holds the command lines executed by a shell, so that they
+ * can be replayed later, e.g. to measure the shell on a real workload. It is
+ * a text file:
+ *
+ *   #shelldon-session 1 TIME
+ *   @DIRECTORY
+ *   DELAY COMMAND_LINE
+ *
+ * TIME is when the recording started (seconds since the Epoch), a line
+ * starting with '@' gives the working directory of the following command
+ * lines, only when it has changed, and DELAY is the number of milliseconds
+ * since the previous command line (or since the start).
+ **/
+#define SESSION_HEADER "#shelldon-session 1"
+
+/**
+ * Starts writing the command lines executed to a session file, which is
+ * truncated.
+ *
+ * @param path The path of the file.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ **/
+int
+session_start_recording (const char *path);
+
+/**
+ * Writes a command line to the session file, if a recording has been
+ * started. It is called by shell_execute_command_line ().
+ *
+ * @param line The command line.
+ **/
+void
+session_record (const char *line);
+
+/**
+ * Closes the session file.
+ **/
+void
+session_stop_recording (void);
+
+/**
+ * Executes the command lines of a session file, in their directories, then
+ * prints to stderr how long they took.
+ *
+ * @param shell  The Shell.
+ * @param path   The path of the file.
+ * @param paced  True to wait between the command lines as long as when they
+ *               were recorded, false to execute them as fast as possible.
+ * @param status If not NULL, will contain the status of the last command.
+ *
+ * @return 0 on success, -1 if the file cannot be read (errno is set).
+ **/
+int
+session_replay (Shell *shell, const char *path, bool paced, int *status);
+
+#endif
@@ -1,25 +1,147 @@
 #include "shell.h"
 
 #include <errno.h>
+#include <signal.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <readline/readline.h>
 #include <readline/history.h>
 
+#include "arena.h"
 #include "array.h"
 #include "assert.h"
+#include "command_line.h"
 #include "debug.h"
 #include "object.h"
+#include "path_cache.h"
+#include "pipeline.h"
+#include "profile.h"
+#include "session.h"
 #include "string.h"
 #include "tools.h"
+#include "usage.h"
+
+#define COMMAND_TABLE_INITIAL_CAPACITY 32
+
+/**
+ * The first line of the file where the durations of the command lines are
+ * saved (see shell_save_command_stats ()).
+ */
+#define STATS_HEADER "#shelldon-stats 1"
+
+/**
+ * The size of the blocks read by shell_execute_fd ().
+ */
+#define READ_BLOCK_SIZE 65536
+
+/**
+ * The initial size of the arena which holds the command line being executed.
+ */
+#define PARSE_ARENA_SIZE 4096
+
+/**
+ * The number of command lines kept in the history of readline.
+ */
+#define HISTORY_SIZE 1000
+
+/**
+ * The size from which the history store is compacted (to half this size).
+ */
+#define HISTORY_STORE_MAX_SIZE (1 << 22)
+
+/**
+ * The maximum length of the pattern typed in shell_search_history ().
+ */
+#define SEARCH_PATTERN_SIZE 256
+
+static CommandLine *
+shell_read_command_line (void *self);
+
+static void
+shell_initialize_readline (void *self);
+
+static void
+shell_append_history (void *self, const char *line);
+
+static void
+shell_load_history (void *self);
+
+static void
+shell_merge_history (void *self);
+
+static void
+shell_add_history_record (const history_record_t *record);
+
+static void
+shell_drop_history_index (void *self);
+
+static int
+shell_search_history (int count, int key);
+
+static void
+shell_wait_history_compaction (void *self);
+
+static void
+shell_compact_history_store (void *self);
 
 static void
 shell_free_command (void *command);
 
+static void
+shell_free_job (void *job);
+
+static void
+shell_handle_sigchld (int signal);
+
+static bool
+shell_job_set_status (job_t *job, pid_t pid, int status);
+
+static void
+shell_remove_job (void *self, const job_t *job);
+
+static void
+shell_run_command (void *self, const command_t *command, Array *args,
+	bool pipeline, int *status);
+
+static void
+shell_add_command_stat (void *self, CommandLine *command_line,
+	const command_t *command, uint64_t duration);
+
+static command_stat_t *
+shell_find_command_stat (Array *stats, const char *name, bool add);
+
+static char *
+shell_get_stats_file (void *self);
+
+static int
+shell_read_command_stats (const char *file, Array *stats);
+
+static void
+shell_free_command_stat (void *stat);
+
+static size_t
+shell_execute_lines (void *self, char *lines, size_t length, bool last,
+	int *status);
+
+static CommandLine *
+shell_parse_once (Shell *self, const char *cmd_line);
+
+static void
+shell_command_table_insert (const command_t **table, size_t capacity,
+	const command_t *command);
+
+static void
+shell_register_command (const void *self, const char *name,
+	func_cmd_t function, const char *args_list, const char *help,
+	bool pipelines);
+
 static void
 shell_real_finalize (void *);
 
@@ -28,6 +150,17 @@ shell_class_real_finalize (void *);
 
 static ShellClass *klass = NULL;
 
+/**
+ * The Shell whose history is searched by shell_search_history (), since the
+ * readline commands do not receive any data.
+ */
+static Shell *search_shell = NULL;
+
+/**
+ * Set by the SIGCHLD handler, reset by shell_update_jobs ().
+ */
+static volatile sig_atomic_t sigchld_received = 0;
+
 ShellClass *
 shell_class_allocate (size_t size, void *parent, char *name)
 {
@@ -65,120 +198,323 @@ shell_construct (size_t size, void *klass, const char *name, const char *prompt)
 	assert (klass);
 	assert (name);
 
+	uint64_t start = profile_now ();
 	Shell *self =  SHELL (object_construct (size, klass));
 
 	self->name = strdup (name);
 	self->prompt = (prompt && *prompt ? strdup (prompt) : NULL);
 	self->default_command = strdup (DEFAULT_COMMAND);
 	self->commands = array_new (shell_free_command);
+	self->command_table = NULL;
+	self->command_table_capacity = 0;
+	self->default_command_cache = NULL;
+	self->parse_cache_size = 0;
+	self->parse_clock = 0;
+	memset (self->parse_seen, 0, sizeof (self->parse_seen));
+	self->arena = arena_new (PARSE_ARENA_SIZE);
+	self->jobs = array_new (shell_free_job);
+	self->interactive = false;
+	self->path_cache = path_cache_new ();
 	self->history_file = NULL;
+	self->history_store = NULL;
+	self->history_loaded = false;
+	self->history_compact_pid = 0;
+	self->history_index = NULL;
 	self->config_dir = NULL;
-	self->done = true;
+	self->readline_initialized = false;
+	memset (&self->last_usage, 0, sizeof (usage_t));
+	self->report_time = -1;
+	self->command_stats = array_new (shell_free_command_stat);
+	self->usage_printed = false;
+	self->done = false;
+
+	// The background programs are reaped by shell_update_jobs ().
+	struct sigaction handler;
+	handler.sa_handler = shell_handle_sigchld;
+	handler.sa_flags = SA_RESTART;
+	sigemptyset (&handler.sa_mask);
+	sigaction (SIGCHLD, &handler, NULL);
 
-	shell_reset (self);
+	// Readline, the configuration directory and the history are only set up
+	// when they are needed.
 
+	profile_add (PROFILE_CONSTRUCT, start);
 	return self;
 }
 
 void
 shell_add_command (const void *self, const char *name, func_cmd_t function,
 	const char *args_list, const char *help)
+{
+	shell_register_command (self, name, function, args_list, help, false);
+}
+
+void
+shell_add_pipeline_command (const void *self, const char *name,
+	func_cmd_t function, const char *args_list, const char *help)
+{
+	shell_register_command (self, name, function, args_list, help, true);
+}
+
+job_t *
+shell_add_job (void *self, pid_t pgid, const pid_t *pids, size_t n,
+	const char *command)
 {
 	assert (self);
-	assert (name);
-	assert (function);
+	assert (pids);
+	assert (command);
+	assert_cmpuint (n, >, 0);
 
-	command_t *p = malloc (sizeof (command_t));
-	assert (p);
+	job_t *job = malloc (sizeof (job_t));
+	assert (job);
 
-	p->name = strdup (name);
-	p->args_list = (args_list ? strdup (args_list) : NULL);
-	p->help = (help ? strdup (help) : NULL);
+	const Array *jobs = shell_get_jobs (self);
+	size_t size = array_get_size (jobs);
+	job->id = (size ? ((job_t *) array_get (jobs, size - 1))->id + 1 : 1);
 
-	p->function = function;
+	job->pgid = pgid;
+	job->pids = malloc (sizeof (pid_t) * n);
+	assert (job->pids);
+	memcpy (job->pids, pids, sizeof (pid_t) * n);
+	job->n_pids = n;
+	job->n_running = n;
+	job->status = 0;
+	job->state = JOB_RUNNING;
+	job->notified = true;
+	job->command = strdup (command);
 
-	array_append (SHELL (self)->commands, p);
+	array_append (SHELL (self)->jobs, job);
+
+	return job;
+}
+
+void
+shell_clear_history (void *self)
+{
+	assert (self);
+
+	clear_history ();
+	shell_drop_history_index (self);
+
+	HistoryStore *store = shell_get_history_store (self);
+	if (store)
+	{
+		shell_wait_history_compaction (self);
+		if (-1 == history_store_clear (store))
+		{
+			perror (history_store_get_path (store));
+		}
+	}
 }
 
 int
-shell_execute_command_line (void *self, Array *command_line, int *status)
+shell_execute_command_line (void *self, CommandLine *command_line,
+	int *status)
 {
 	assert (self);
 	assert (!array_is_empty (command_line));
 
-	const command_t *p = shell_get_command (self, array_get (command_line, 0));
-	if (p)
+	uint64_t start = profile_now ();
+	session_record (command_line_get_text (command_line));
+	usage_t usage;
+	usage_begin (&usage);
+	SHELL (self)->usage_printed = false;
+
+	// The command line may be shared, so the name is skipped without removing it.
+	Array *args = ARRAY (command_line);
+	uint64_t lookup_start = profile_now ();
+	const char *name = array_get (command_line, 0);
+	const command_t *p = (name ? shell_get_command (self, name) : NULL);
+	const command_t *builtin = p;
+	if (!p)
 	{
-		array_remove_at (command_line, 0);
+		p = shell_get_default_command (self);
 	}
-	else if ( !(p = shell_get_default_command (self)) )
+	profile_add (PROFILE_LOOKUP, lookup_start);
+	if (!p)
 	{
+		usage_end (&usage);
+		profile_add (PROFILE_EXECUTE_COMMAND_LINE, start);
 		return -1;
 	}
-	if (status)
+	if (builtin)
 	{
-		*status = p->function (self, command_line);
+		args = command_line_get_arguments (command_line);
 	}
-	else
+	shell_run_command (self, p, args, command_line_is_pipeline (command_line),
+		status);
+
+	usage_end (&usage);
+	if (builtin || usage.n_programs) // Not for the programs not found.
+	{
+		shell_add_command_stat (self, command_line, builtin, usage.wall / 1000);
+	}
+	if (usage.n_programs)
 	{
-		p->function (self, command_line);
+		SHELL (self)->last_usage = usage;
+		long report_time = SHELL (self)->report_time;
+		if (report_time >= 0 && !SHELL (self)->usage_printed
+			&& usage.wall >= (uint64_t) report_time * 1000000)
+		{
+			shell_print_usage (self, &usage);
+		}
 	}
 
+	profile_add (PROFILE_EXECUTE_COMMAND_LINE, start);
 	return 0;
 }
 
-const command_t *
-shell_get_command (const void *self, const char *name)
+int
+shell_execute_words (void *self, Array *words, int *status)
 {
 	assert (self);
-	assert (name);
+	assert (!array_is_empty (words));
 
+	bool pipeline = false;
+	for (size_t i = 0, size = array_get_size (words); i < size && !pipeline;
+		++i)
+	{
+		pipeline = !array_get (words, i);
+	}
 
-	const Array *commands = shell_get_commands (self);
-	for (
-		size_t i = 0, n = array_get_size (commands);
-		i < n;
-		++i
-	)
+	const char *name = array_get (words, 0);
+	const command_t *p = (name ? shell_get_command (self, name) : NULL);
+	if (p)
 	{
-		const command_t *c = array_get (commands, i);
-		if (!strcmp (c->name, name))
+		Array *args = array_new (NULL);
+		for (size_t i = 1, size = array_get_size (words); i < size; ++i)
 		{
-			return c;
+			array_append (args, array_get (words, i));
 		}
+		shell_run_command (self, p, args, pipeline, status);
+		object_unref (args);
+	}
+	else if ( (p = shell_get_default_command (self)) )
+	{
+		shell_run_command (self, p, words, pipeline, status);
+	}
+	else
+	{
+		return -1;
 	}
 
-	return NULL;
+	return 0;
 }
 
-Array *
-shell_get_command_line (void *self)
+int
+shell_execute_fd (void *self, int fd, int *status)
 {
 	assert (self);
 
-	if (shell_is_done (self))
+	size_t capacity = READ_BLOCK_SIZE;
+	size_t length = 0;
+	char *buffer = malloc (capacity);
+	assert (buffer);
+
+	int return_value = 0;
+	while (!shell_is_done (self))
 	{
-		shell_reset (self);
+		if (capacity - length < READ_BLOCK_SIZE) // A line is longer than a block.
+		{
+			capacity <<= 1;
+			buffer = realloc (buffer, capacity);
+			assert (buffer);
+		}
+
+		ssize_t n = read (fd, buffer + length, capacity - length);
+		if (-1 == n)
+		{
+			if (EINTR == errno)
+			{
+				continue;
+			}
+			return_value = -1;
+			break;
+		}
+		length += n;
+
+		size_t done = shell_execute_lines (self, buffer, length, !n, status);
+
+		// Keeps the incomplete last line for the next block.
+		length -= done;
+		memmove (buffer, buffer + done, length);
+
+		if (!n) // End of file.
+		{
+			break;
+		}
 	}
+	free (buffer);
 
-	char *string = readline (shell_get_prompt (self));
-	if (!string)
+	return return_value;
+}
+
+void
+shell_execute_string (void *self, const char *string, int *status)
+{
+	assert (self);
+	assert (string);
+
+	size_t length = strlen (string);
+	char *lines = malloc (length + 1);
+	assert (lines);
+	memcpy (lines, string, length + 1);
+
+	shell_execute_lines (self, lines, length, true, status);
+
+	free (lines);
+}
+
+const command_t *
+shell_get_command (const void *self, const char *name)
+{
+	assert (self);
+	assert (name);
+
+
+	size_t capacity = SHELL (self)->command_table_capacity;
+	if (!capacity) // No commands registered.
 	{
-		putchar ('\n');
-		shell_stop (self);
 		return NULL;
 	}
-	if ('\0' == *string || shell_is_done (self))
+
+	const command_t **table = SHELL (self)->command_table;
+	size_t hash = string_hash (name);
+	for (size_t i = hash & (capacity - 1); table[i]; i = (i + 1) & (capacity - 1))
 	{
-		free (string);
-		return NULL;
+		if (table[i]->hash == hash && !strcmp (table[i]->name, name))
+		{
+			return table[i];
+		}
 	}
-	add_history (string);
 
-	Array *a = shell_parse_command_line (string);
-	free (string);
+	return NULL;
+}
+
+const command_t *
+shell_get_default_command (void *self)
+{
+	assert (self);
+
+	if (!SHELL (self)->default_command_cache)
+	{
+		SHELL (self)->default_command_cache = shell_get_command (self,
+			SHELL (self)->default_command);
+	}
+
+	return SHELL (self)->default_command_cache;
+}
+
+CommandLine *
+shell_get_command_line (void *self)
+{
+	assert (self);
+
+	uint64_t start = profile_now ();
+	CommandLine *command_line = shell_read_command_line (self);
+	profile_add (PROFILE_GET_COMMAND_LINE, start);
 
-	return a;
+	return command_line;
 }
 
 const char *
@@ -204,6 +540,34 @@ shell_get_config_dir (void *self)
 	return SHELL (self)->config_dir;
 }
 
+job_t *
+shell_get_job (const void *self, unsigned int id)
+{
+	assert (self);
+
+	const Array *jobs = shell_get_jobs (self);
+	size_t size = array_get_size (jobs);
+	if (!size)
+	{
+		return NULL;
+	}
+	if (!id) // The most recent one.
+	{
+		return array_get (jobs, size - 1);
+	}
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		job_t *job = array_get (jobs, i);
+		if (job->id == id)
+		{
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
 const char *
 shell_get_history_file (void *self)
 {
@@ -222,115 +586,1232 @@ shell_get_history_file (void *self)
 	return SHELL (self)->history_file;
 }
 
-Array *
-shell_parse_command_line(const char *cmd_line)
+HistoryIndex *
+shell_get_history_index (void *self)
 {
-	size_t cmd_line_lg = strlen (cmd_line);
-
-	Array *result = array_new (free);
-
-	String *buffer = string_new ();
+	assert (self);
 
-	char current_delim = ' ';
-	bool escaped = false;
+	if (SHELL (self)->history_index)
+	{
+		return SHELL (self)->history_index;
+	}
 
-	for (register size_t i = 0; i < cmd_line_lg; ++i)
+	HistoryIndex *index = history_index_new ();
+	HistoryStore *store = shell_get_history_store (self);
+	if (store)
 	{
-		if (!escaped && cmd_line[i] == '\\')
-		{
-			escaped = true;
-		}
-		else if (!escaped && cmd_line[i] == ' ' && current_delim == ' ')
-		{
-			if (string_get_length (buffer))
-			{
-				array_append (result, string_steal (buffer));
-			}
-		}
-		else if (!escaped && ((cmd_line[i] == '\'' && current_delim != '"')
-				|| (cmd_line[i] == '"' && current_delim != '\'')))
-		{
-			if (string_get_length (buffer))
-			{
-				array_append (result, string_steal (buffer));
-			}
-			if (current_delim == ' ')
-			{
-				current_delim = cmd_line[i];
-			}
-			else
-			{
-				current_delim = ' ';
-			}
-		}
-		else
+		Array *records = array_new (NULL);
+		for (size_t i = history_store_get_recent (store, (size_t) -1, records);
+			i > 0; --i)
 		{
-			if (escaped)
-			{
-				escaped = false;
-			}
-			string_append_char (buffer, cmd_line[i]);
+			const history_record_t *record = array_get (records, i - 1);
+			history_index_add (index, record->text);
 		}
+		object_unref (records);
 	}
-	if (string_get_length (buffer))
+	else
 	{
-		array_append (result, string_steal (buffer));
+		HIST_ENTRY **entries = history_list ();
+		for (size_t i = 0; entries && entries[i]; ++i)
+		{
+			history_index_add (index, entries[i]->line);
+		}
 	}
-	object_unref (buffer);
+	debug ("History index built: %zu command lines",
+		history_index_get_size (index));
 
-	return result;
+	return (SHELL (self)->history_index = index);
 }
 
-void
-shell_reset (void *self)
+HistoryStore *
+shell_get_history_store (void *self)
 {
 	assert (self);
 
-	rl_readline_name = shell_get_name (self);
-
-	using_history ();
-	const char *history_file = shell_get_history_file (self);
-	if (history_file)
+	if ( !(SHELL (self)->history_store) )
 	{
-		read_history (history_file);
+		const char *config_dir = shell_get_config_dir (self);
+		if (config_dir)
+		{
+			char *path = string_concat (NULL, config_dir, "/history.bin", NULL);
+			SHELL (self)->history_store = history_store_new (path);
+			free (path);
+		}
 	}
 
-	rl_initialize ();
-
-	SHELL (self)->done = false;
+	return SHELL (self)->history_store;
 }
 
-static void
-shell_free_command (void *p)
+int
+shell_import_history (void *self, const char *file)
 {
-	assert (p);
-
-	command_t *command = p;
+	assert (self);
+	assert (file);
 
-	free (command->name);
-	free (command->args_list);
-	free (command->help);
+	HistoryStore *store = shell_get_history_store (self);
+	if (store)
+	{
+		shell_wait_history_compaction (self);
+		if (-1 == history_store_import (store, file))
+		{
+			return -1;
+		}
+		clear_history ();
+		shell_drop_history_index (self);
+		shell_load_history (self);
+		return 0;
+	}
 
-	free (command);
+	shell_drop_history_index (self);
+	int error = read_history (file);
+	if (error)
+	{
+		errno = error;
+		return -1;
+	}
+	return 0;
 }
 
-static void
-shell_real_finalize (void *self)
+CommandLine *
+shell_parse (void *self, const char *cmd_line)
 {
 	assert (self);
-	assert (klass);
+	assert (cmd_line);
 
-	if (SHELL (self)->history_file)
+	Shell *shell = SHELL (self);
+
+	// Long lines are never kept, so they are neither hashed nor looked up.
+	if (SHELL_PARSE_CACHE_MAX_LENGTH
+		== strnlen (cmd_line, SHELL_PARSE_CACHE_MAX_LENGTH))
 	{
-		write_history (SHELL (self)->history_file);
-		free (SHELL (self)->history_file);
+		return shell_parse_once (shell, cmd_line);
 	}
-	clear_history ();
 
-	free (SHELL (self)->name);
-	free (SHELL (self)->prompt);
-	free (SHELL (self)->default_command);
-	free (SHELL (self)->config_dir);
+	size_t hash = string_hash (cmd_line);
+	++shell->parse_clock;
+
+	// The least recently used entry is found while looking for the line.
+	parse_cache_entry_t *lru = NULL;
+	for (size_t i = 0; i < shell->parse_cache_size; ++i)
+	{
+		parse_cache_entry_t *entry = shell->parse_cache + i;
+		if (entry->hash == hash
+			&& 0 == strcmp (command_line_get_text (entry->command_line), cmd_line))
+		{
+			entry->last_use = shell->parse_clock;
+			return object_ref (entry->command_line);
+		}
+		if (!lru || entry->last_use < lru->last_use)
+		{
+			lru = entry;
+		}
+	}
+
+	// A command line is only kept once it is repeated.
+	size_t *seen = shell->parse_seen + (hash & (SHELL_PARSE_SEEN_SIZE - 1));
+	if (*seen != hash)
+	{
+		*seen = hash;
+		return shell_parse_once (shell, cmd_line);
+	}
+	CommandLine *command_line = command_line_new (cmd_line);
+
+	parse_cache_entry_t *entry;
+	if (shell->parse_cache_size < SHELL_PARSE_CACHE_SIZE)
+	{
+		entry = shell->parse_cache + shell->parse_cache_size++;
+	}
+	else
+	{
+		// The command line may still be referenced elsewhere.
+		entry = lru;
+		object_unref (entry->command_line);
+	}
+	entry->hash = hash;
+	entry->last_use = shell->parse_clock;
+	entry->command_line = object_ref (command_line);
+
+	return command_line;
+}
+
+/**
+ * Builds a command line which is not kept in the parse cache, in the arena of
+ * the Shell unless it is busy (a command line executing another one).
+ */
+static CommandLine *
+shell_parse_once (Shell *self, const char *cmd_line)
+{
+	return (arena_is_empty (self->arena)
+		? command_line_new_in_arena (cmd_line, self->arena)
+		: command_line_new (cmd_line));
+}
+
+Array *
+shell_parse_command_line(const char *cmd_line)
+{
+	CommandLine *words = command_line_new (cmd_line);
+
+	// Each word is copied since the result owns them.
+	size_t size = array_get_size (words);
+	Array *result = array_new (free);
+	array_ensure_capacity (result, size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		const char *word = array_get (words, i);
+		array_append (result, (word ? strdup (word) : NULL));
+	}
+
+	object_unref (words);
+
+	return result;
+}
+
+Array *
+shell_get_command_stats (void *self)
+{
+	assert (self);
+
+	Array *stats = array_new (shell_free_command_stat);
+	char *file = shell_get_stats_file (self);
+	if (file)
+	{
+		shell_read_command_stats (file, stats);
+		free (file);
+	}
+
+	const Array *session = SHELL (self)->command_stats;
+	for (size_t i = 0, n = array_get_size (session); i < n; ++i)
+	{
+		const command_stat_t *stat = array_get (session, i);
+		histogram_merge (shell_find_command_stat (stats, stat->name, true)->histogram,
+			stat->histogram);
+	}
+
+	return stats;
+}
+
+int
+shell_reset_command_stats (void *self)
+{
+	assert (self);
+
+	array_clear (SHELL (self)->command_stats);
+
+	// The file is kept so that the durations are still saved.
+	char *file = shell_get_stats_file (self);
+	int result = 0;
+	if (file && 0 == access (file, F_OK))
+	{
+		FILE *stream = fopen (file, "w");
+		if (!stream)
+		{
+			result = -1;
+		}
+		else
+		{
+			fputs (STATS_HEADER "\n", stream);
+			result = fclose (stream);
+		}
+	}
+	free (file);
+
+	return result;
+}
+
+int
+shell_save_command_stats (void *self, bool create)
+{
+	assert (self);
+
+	if (!create && array_is_empty (SHELL (self)->command_stats))
+	{
+		return 0;
+	}
+	char *file = shell_get_stats_file (self);
+	if (!file)
+	{
+		errno = ENOENT;
+		return -1;
+	}
+
+	// The file may have been updated by other shells since it was read.
+	Array *stats = array_new (shell_free_command_stat);
+	if (-1 == shell_read_command_stats (file, stats)
+		&& (ENOENT != errno || !create))
+	{
+		int error = errno;
+		object_unref (stats);
+		free (file);
+		if (ENOENT == error) // The durations are not saved.
+		{
+			return 0;
+		}
+		errno = error;
+		return -1;
+	}
+
+	Array *session = SHELL (self)->command_stats;
+	for (size_t i = 0, n = array_get_size (session); i < n; ++i)
+	{
+		const command_stat_t *stat = array_get (session, i);
+		histogram_merge (shell_find_command_stat (stats, stat->name, true)->histogram,
+			stat->histogram);
+	}
+
+	// The file is replaced at once so that it is never read half-written.
+	char *temporary = string_concat (NULL, file, ".XXXXXX", NULL);
+	int fd = mkstemp (temporary);
+	FILE *stream = (-1 == fd ? NULL : fdopen (fd, "w"));
+	int result = -1;
+	if (stream)
+	{
+		fputs (STATS_HEADER "\n", stream);
+		for (size_t i = 0, n = array_get_size (stats); i < n; ++i)
+		{
+			const command_stat_t *stat = array_get (stats, i);
+			histogram_write (stat->histogram, stream);
+			fprintf (stream, "\t%s\n", stat->name);
+		}
+		if (0 == fclose (stream) && 0 == rename (temporary, file))
+		{
+			array_clear (session);
+			result = 0;
+		}
+		else
+		{
+			unlink (temporary);
+		}
+	}
+	else if (-1 != fd)
+	{
+		close (fd);
+		unlink (temporary);
+	}
+
+	free (temporary);
+	object_unref (stats);
+	free (file);
+	return result;
+}
+
+int
+shell_unsave_command_stats (void *self)
+{
+	assert (self);
+
+	char *file = shell_get_stats_file (self);
+	int result = (file && -1 == unlink (file) && ENOENT != errno ? -1 : 0);
+	free (file);
+
+	return result;
+}
+
+void
+shell_print_usage (void *self, const usage_t *usage)
+{
+	assert (self);
+	assert (usage);
+
+	usage_print (stderr, usage);
+	SHELL (self)->usage_printed = true;
+}
+
+void
+shell_print_job (const void *self, const job_t *job)
+{
+	assert (self);
+	assert (job);
+
+	const char *state;
+	if (JOB_RUNNING == job->state)
+	{
+		state = "Running";
+	}
+	else if (JOB_STOPPED == job->state)
+	{
+		state = "Stopped";
+	}
+	else
+	{
+		state = "Done";
+	}
+
+	printf ("[%u] %-8s %s\n", job->id, state, job->command);
+}
+
+void
+shell_set_default_command (void *self, const char *name)
+{
+	assert (self);
+	assert (name);
+
+	free (SHELL (self)->default_command);
+	SHELL (self)->default_command = strdup (name);
+	SHELL (self)->default_command_cache = NULL;
+}
+
+void
+shell_reset (void *self)
+{
+	assert (self);
+
+	uint64_t start = profile_now ();
+	SHELL (self)->readline_initialized = false;
+	SHELL (self)->history_loaded = false;
+	SHELL (self)->done = false;
+	profile_add (PROFILE_RESET, start);
+}
+
+/**
+ * Does the work of shell_get_command_line ().
+ */
+static CommandLine *
+shell_read_command_line (void *self)
+{
+	if (shell_is_done (self))
+	{
+		shell_reset (self);
+	}
+
+	uint64_t start = profile_now ();
+	if (!SHELL (self)->readline_initialized)
+	{
+		shell_initialize_readline (self);
+		profile_add (PROFILE_READLINE_INIT, start);
+	}
+
+	start = profile_now ();
+	if (!SHELL (self)->history_loaded)
+	{
+		shell_load_history (self);
+	}
+	else
+	{
+		shell_merge_history (self);
+	}
+	profile_add (PROFILE_HISTORY, start);
+
+	// The shell is ready, unless this is not the first prompt.
+	profile_report_startup ();
+
+	start = profile_now ();
+	char *string = readline (shell_get_prompt (self));
+	profile_add (PROFILE_READLINE, start);
+	if (!string)
+	{
+		putchar ('\n');
+		shell_stop (self);
+		return NULL;
+	}
+	if ('\0' == *string || shell_is_done (self))
+	{
+		free (string);
+		return NULL;
+	}
+	shell_append_history (self, string);
+
+	start = profile_now ();
+	CommandLine *command_line = shell_parse (self, string);
+	profile_add (PROFILE_PARSE, start);
+	free (string);
+
+	if (array_is_empty (command_line))
+	{
+		object_unref (command_line);
+		return NULL;
+	}
+	return command_line;
+}
+
+/**
+ * Initializes readline (which reads its configuration file) for the shell.
+ */
+static void
+shell_initialize_readline (void *self)
+{
+	rl_readline_name = shell_get_name (self);
+
+	// The reverse search of readline reads all the history for each key.
+	search_shell = self;
+	rl_bind_key (CTRL ('R'), shell_search_history);
+
+	// The history is read after, by shell_get_command_line ().
+	using_history ();
+	stifle_history (HISTORY_SIZE);
+
+	rl_initialize ();
+
+	SHELL (self)->readline_initialized = true;
+}
+
+/**
+ * Adds "line" to the history and appends it to the history store.
+ */
+static void
+shell_append_history (void *self, const char *line)
+{
+	add_history (line);
+	if (SHELL (self)->history_index)
+	{
+		history_index_add (SHELL (self)->history_index, line);
+	}
+
+	HistoryStore *store = shell_get_history_store (self);
+	if (!store)
+	{
+		return;
+	}
+
+	// The file may have been replaced by the compaction.
+	if (SHELL (self)->history_compact_pid)
+	{
+		shell_wait_history_compaction (self);
+		history_store_close (store);
+	}
+
+	if (-1 != history_store_append (store, line, time (NULL))
+		&& history_store_get_size (store) > HISTORY_STORE_MAX_SIZE)
+	{
+		shell_compact_history_store (self);
+	}
+}
+
+/**
+ * Fills the history of readline with the HISTORY_SIZE most recent command
+ * lines of the history store, importing the text history file first if the
+ * store does not exist yet.
+ */
+static void
+shell_load_history (void *self)
+{
+	SHELL (self)->history_loaded = true;
+
+	HistoryStore *store = shell_get_history_store (self);
+	if (!store)
+	{
+		return;
+	}
+
+	if (!history_store_exists (store))
+	{
+		const char *history_file = shell_get_history_file (self);
+		if (0 == access (history_file, F_OK)
+			&& -1 == history_store_import (store, history_file))
+		{
+			perror (history_file);
+		}
+	}
+
+	// Only the records which are added are read from the file.
+	Array *records = array_new (NULL);
+	for (size_t i = history_store_get_recent (store, HISTORY_SIZE, records);
+		i > 0; --i)
+	{
+		shell_add_history_record (array_get (records, i - 1));
+	}
+	object_unref (records);
+}
+
+/**
+ * Adds to the history the command lines appended to the history store by the
+ * other shells since the last call.
+ */
+static void
+shell_merge_history (void *self)
+{
+	HistoryStore *store = SHELL (self)->history_store;
+	if (!store)
+	{
+		return;
+	}
+
+	Array *records = array_new (NULL);
+	size_t n = history_store_read_new (store, records);
+	for (size_t i = 0; i < n; ++i)
+	{
+		const history_record_t *record = array_get (records, i);
+		shell_add_history_record (record);
+		if (SHELL (self)->history_index)
+		{
+			history_index_add (SHELL (self)->history_index, record->text);
+		}
+	}
+	if (n)
+	{
+		debug ("%zu command lines merged from the history store", n);
+	}
+	object_unref (records);
+}
+
+/**
+ * Adds the command line of "record" to the history of readline, with its time.
+ */
+static void
+shell_add_history_record (const history_record_t *record)
+{
+	add_history (record->text);
+	if (record->time)
+	{
+		char timestamp[24];
+		snprintf (timestamp, sizeof (timestamp), "#%lld",
+			(long long) record->time);
+		add_history_time (timestamp);
+	}
+}
+
+/**
+ * Releases the history index so that it is built again when needed.
+ */
+static void
+shell_drop_history_index (void *self)
+{
+	if (SHELL (self)->history_index)
+	{
+		object_unref (SHELL (self)->history_index);
+		SHELL (self)->history_index = NULL;
+	}
+}
+
+/**
+ * The readline command bound to Ctrl-R: an incremental reverse search which
+ * uses the history index.
+ *
+ * Each typed character looks for the pattern from the current match, Ctrl-R
+ * looks for an older match, Ctrl-G restores the line and any other key keeps
+ * the match and is then handled normally.
+ */
+static int
+shell_search_history (int count, int key)
+{
+	assert (search_shell);
+
+	HistoryIndex *index = shell_get_history_index (search_shell);
+	char *saved_line = strdup (rl_line_buffer);
+	assert (saved_line);
+	int saved_point = rl_point;
+
+	char pattern[SEARCH_PATTERN_SIZE];
+	size_t length = 0;
+	pattern[0] = '\0';
+	size_t match = HISTORY_INDEX_NONE;
+	bool failed = false;
+	for (;;)
+	{
+		rl_message ("(%sreverse-i-search)`%s': ", (failed ? "failed " : ""),
+			pattern);
+
+		int c = rl_read_key ();
+		size_t before;
+		if (CTRL ('R') == c)
+		{
+			before = (HISTORY_INDEX_NONE == match ? history_index_get_size (index)
+				: match);
+		}
+		else if (RUBOUT == c || CTRL ('H') == c)
+		{
+			if (length)
+			{
+				pattern[--length] = '\0';
+			}
+			before = history_index_get_size (index);
+		}
+		else if (CTRL ('G') == c)
+		{
+			rl_replace_line (saved_line, 0);
+			rl_point = saved_point;
+			break;
+		}
+		else if (c >= ' ' && c != RUBOUT && length + 1 < sizeof (pattern))
+		{
+			pattern[length++] = (char) c;
+			pattern[length] = '\0';
+
+			// The current match may still match.
+			before = (HISTORY_INDEX_NONE == match ? history_index_get_size (index)
+				: match + 1);
+		}
+		else // E.g. Enter or the first character of an arrow key sequence.
+		{
+			rl_execute_next (c);
+			break;
+		}
+
+		size_t found = (length ? history_index_search (index, pattern, before)
+			: HISTORY_INDEX_NONE);
+		failed = (length && HISTORY_INDEX_NONE == found);
+		if (HISTORY_INDEX_NONE != found)
+		{
+			match = found;
+			const char *line = history_index_get (index, match);
+			rl_replace_line (line, 0);
+			rl_point = (int) (strstr (line, pattern) - line);
+		}
+	}
+
+	free (saved_line);
+	rl_clear_message ();
+	rl_redisplay ();
+
+	return 0;
+}
+
+/**
+ * Waits for the compaction of the history store to be done, if any.
+ */
+static void
+shell_wait_history_compaction (void *self)
+{
+	pid_t pid = SHELL (self)->history_compact_pid;
+	if (pid)
+	{
+		waitpid (pid, NULL, 0);
+		SHELL (self)->history_compact_pid = 0;
+	}
+}
+
+/**
+ * Compacts the history store to half of HISTORY_STORE_MAX_SIZE in a child
+ * process, so that the user does not wait for the file to be rewritten.
+ */
+static void
+shell_compact_history_store (void *self)
+{
+	HistoryStore *store = shell_get_history_store (self);
+	assert (store);
+
+	shell_wait_history_compaction (self);
+
+	pid_t pid = fork ();
+	if (0 == pid)
+	{
+		_exit (history_store_compact (store, HISTORY_STORE_MAX_SIZE / 2)
+			? EXIT_FAILURE : EXIT_SUCCESS);
+	}
+	else if (pid > 0)
+	{
+		SHELL (self)->history_compact_pid = pid;
+	}
+}
+
+/**
+ * Runs a command found for a command line, with the words following its name
+ * or all the words for the default command.
+ */
+static void
+shell_run_command (void *self, const command_t *command, Array *args,
+	bool pipeline, int *status)
+{
+	if (pipeline && !command->pipelines)
+	{
+		fprintf (stderr, "The command %s cannot be used in a pipeline.\n",
+			command->name);
+		if (status)
+		{
+			*status = -1;
+		}
+	}
+	else if (status)
+	{
+		*status = command->function (self, args);
+	}
+	else
+	{
+		command->function (self, args);
+	}
+}
+
+/**
+ * Adds the duration of a command line to the stats of its command, which is
+ * named after the builtin "command" or after its programs.
+ */
+static void
+shell_add_command_stat (void *self, CommandLine *command_line,
+	const command_t *command, uint64_t duration)
+{
+	const char *name = (command ? command->name : array_get (command_line, 0));
+	String *names = NULL;
+	if (!command && command_line_is_pipeline (command_line))
+	{
+		names = string_new ();
+		bool first_word = true;
+		for (size_t i = 0, n = array_get_size (command_line); i < n; ++i)
+		{
+			const char *word = array_get (command_line, i);
+			if (!word)
+			{
+				string_append (names, " | ");
+				first_word = true;
+			}
+			else if (first_word)
+			{
+				string_append (names, word);
+				first_word = false;
+			}
+		}
+		name = string_get_chars (names);
+	}
+
+	if (name)
+	{
+		command_stat_t *stat = shell_find_command_stat (
+			SHELL (self)->command_stats, name, true);
+		histogram_add (stat->histogram, duration);
+	}
+	if (names)
+	{
+		object_unref (names);
+	}
+}
+
+/**
+ * Returns the stats of the command "name" or NULL if they are not found and
+ * "add" is false.
+ */
+static command_stat_t *
+shell_find_command_stat (Array *stats, const char *name, bool add)
+{
+	size_t hash = string_hash (name);
+	for (size_t i = 0, n = array_get_size (stats); i < n; ++i)
+	{
+		command_stat_t *stat = array_get (stats, i);
+		if (stat->hash == hash && 0 == strcmp (stat->name, name))
+		{
+			return stat;
+		}
+	}
+	if (!add)
+	{
+		return NULL;
+	}
+
+	command_stat_t *stat = malloc (sizeof (command_stat_t));
+	assert (stat);
+	stat->name = strdup (name);
+	assert (stat->name);
+	stat->hash = hash;
+	stat->histogram = histogram_new ();
+	array_append (stats, stat);
+
+	return stat;
+}
+
+/**
+ * Returns the path of the file where the durations of the command lines are
+ * saved, which must be freed, or NULL.
+ */
+static char *
+shell_get_stats_file (void *self)
+{
+	const char *config_dir = shell_get_config_dir (self);
+	return (config_dir ? string_concat (NULL, config_dir, "/stats", NULL)
+		: NULL);
+}
+
+/**
+ * Adds the durations saved in "file" to "stats". The invalid lines are
+ * skipped.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+static int
+shell_read_command_stats (const char *file, Array *stats)
+{
+	FILE *stream = fopen (file, "re");
+	if (!stream)
+	{
+		return -1;
+	}
+
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t length;
+	while (-1 != (length = getline (&line, &size, stream)))
+	{
+		if (length && '\n' == line[length - 1])
+		{
+			line[--length] = '\0';
+		}
+		char *name = strchr (line, '\t');
+		if ('#' == *line || !name || !name[1])
+		{
+			continue;
+		}
+		*name++ = '\0';
+
+		Histogram *histogram = histogram_new ();
+		if (0 == histogram_read (histogram, line))
+		{
+			histogram_merge (shell_find_command_stat (stats, name, true)->histogram,
+				histogram);
+		}
+		object_unref (histogram);
+	}
+	free (line);
+	fclose (stream);
+
+	return 0;
+}
+
+static void
+shell_free_command_stat (void *p)
+{
+	assert (p);
+
+	command_stat_t *stat = p;
+
+	object_unref (stat->histogram);
+	free (stat->name);
+
+	free (stat);
+}
+
+/**
+ * Executes each complete line of "lines" (which are modified) and returns the
+ * number of bytes consumed. If "last" is true, the trailing characters are
+ * considered as a complete line.
+ */
+static size_t
+shell_execute_lines (void *self, char *lines, size_t length, bool last,
+	int *status)
+{
+	size_t start = 0;
+	while (start < length && !shell_is_done (self))
+	{
+		char *line = lines + start;
+		char *end = memchr (line, '\n', length - start);
+		if (end)
+		{
+			start = (size_t) (end - lines) + 1;
+		}
+		else if (last)
+		{
+			end = lines + length;
+			start = length;
+		}
+		else // Incomplete line.
+		{
+			break;
+		}
+		*end = '\0';
+
+		if ('\0' == *line || '#' == *line) // Empty line or comment.
+		{
+			continue;
+		}
+
+		shell_update_jobs (self);
+
+		uint64_t parse_start = profile_now ();
+		CommandLine *command_line = shell_parse (self, line);
+		profile_add (PROFILE_PARSE, parse_start);
+		if (!array_is_empty (command_line)
+			&& -1 == shell_execute_command_line (self, command_line, status))
+		{
+			fprintf (stderr, "Unable to execute \"%s\".\n", line);
+		}
+		object_unref (command_line);
+	}
+
+	return start;
+}
+
+static void
+shell_register_command (const void *self, const char *name,
+	func_cmd_t function, const char *args_list, const char *help,
+	bool pipelines)
+{
+	assert (self);
+	assert (name);
+	assert (function);
+
+	command_t *p = malloc (sizeof (command_t));
+	assert (p);
+
+	p->name = strdup (name);
+	p->args_list = (args_list ? strdup (args_list) : NULL);
+	p->help = (help ? strdup (help) : NULL);
+
+	p->function = function;
+	p->hash = string_hash (name);
+	p->pipelines = pipelines;
+
+	array_append (SHELL (self)->commands, p);
+
+	// Keeps the load factor of the table under 1/2.
+	Shell *shell = SHELL (self);
+	size_t size = array_get_size (shell->commands);
+	if ( (size << 1) > shell->command_table_capacity )
+	{
+		size_t capacity = (shell->command_table_capacity
+			? shell->command_table_capacity << 1
+			: COMMAND_TABLE_INITIAL_CAPACITY);
+
+		const command_t **table = calloc (capacity, sizeof (command_t *));
+		assert (table);
+
+		for (size_t i = 0; i < shell->command_table_capacity; ++i)
+		{
+			if (shell->command_table[i])
+			{
+				shell_command_table_insert (table, capacity,
+					shell->command_table[i]);
+			}
+		}
+		free (shell->command_table);
+
+		shell->command_table = table;
+		shell->command_table_capacity = capacity;
+
+		debug ("New command table capacity: %zu", capacity);
+	}
+	shell_command_table_insert (shell->command_table,
+		shell->command_table_capacity, p);
+
+	// The default command may just have been registered.
+	shell->default_command_cache = NULL;
+}
+
+/**
+ * Inserts "command" in the first free slot of its probe sequence.
+ *
+ * If a command with the same name is already in the table, it is kept (the
+ * first registered command wins, as with the former linear lookup).
+ */
+static void
+shell_command_table_insert (const command_t **table, size_t capacity,
+	const command_t *command)
+{
+	size_t i = command->hash & (capacity - 1);
+	for (; table[i]; i = (i + 1) & (capacity - 1))
+	{
+		if (table[i]->hash == command->hash
+			&& !strcmp (table[i]->name, command->name))
+		{
+			return;
+		}
+	}
+
+	table[i] = command;
+}
+
+void
+shell_update_jobs (void *self)
+{
+	assert (self);
+
+	if (!sigchld_received)
+	{
+		return;
+	}
+	sigchld_received = 0;
+
+	// Reaps every child which has changed of state.
+	const Array *jobs = shell_get_jobs (self);
+	pid_t pid;
+	int status;
+	while (0 < (pid = waitpid (-1, &status, WNOHANG | WUNTRACED | WCONTINUED)))
+	{
+		if (pid == SHELL (self)->history_compact_pid)
+		{
+			SHELL (self)->history_compact_pid = 0;
+			continue;
+		}
+		for (size_t i = 0, n = array_get_size (jobs); i < n; ++i)
+		{
+			if (shell_job_set_status (array_get (jobs, i), pid, status))
+			{
+				break;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < array_get_size (jobs);)
+	{
+		job_t *job = array_get (jobs, i);
+		if (!job->notified)
+		{
+			if (shell_is_interactive (self))
+			{
+				shell_print_job (self, job);
+			}
+			job->notified = true;
+		}
+
+		if (JOB_DONE == job->state)
+		{
+			array_remove_at (SHELL (self)->jobs, i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+int
+shell_wait_job (void *self, job_t *job, bool foreground)
+{
+	assert (self);
+	assert (job);
+
+	foreground = foreground && shell_is_interactive (self);
+	if (foreground)
+	{
+		give_terminal (job->pgid);
+	}
+
+	for (size_t i = 0; i < job->n_pids && JOB_STOPPED != job->state; ++i)
+	{
+		while (job->pids[i] && JOB_STOPPED != job->state)
+		{
+			pid_t pid = job->pids[i];
+			int status;
+			if (-1 != usage_wait (pid, &status, WUNTRACED))
+			{
+				shell_job_set_status (job, pid, status);
+			}
+			else if (EINTR != errno) // Should not happen, forgets it.
+			{
+				shell_job_set_status (job, pid, 0);
+			}
+		}
+	}
+
+	// The job may also have been given the terminal when it was started.
+	if (isatty (STDIN_FILENO) && tcgetpgrp (STDIN_FILENO) == job->pgid)
+	{
+		give_terminal (getpgrp ());
+	}
+
+	if (JOB_STOPPED == job->state)
+	{
+		return -1;
+	}
+
+	int status = job->status;
+	shell_remove_job (self, job);
+	return status;
+}
+
+static void
+shell_free_command (void *p)
+{
+	assert (p);
+
+	command_t *command = p;
+
+	free (command->name);
+	free (command->args_list);
+	free (command->help);
+
+	free (command);
+}
+
+static void
+shell_free_job (void *p)
+{
+	assert (p);
+
+	job_t *job = p;
+
+	free (job->pids);
+	free (job->command);
+
+	free (job);
+}
+
+static void
+shell_handle_sigchld (int signal)
+{
+	sigchld_received = 1;
+}
+
+/**
+ * Updates the job if "pid" is one of its programs and returns true, else
+ * returns false.
+ */
+static bool
+shell_job_set_status (job_t *job, pid_t pid, int status)
+{
+	size_t i = 0;
+	while (i < job->n_pids && job->pids[i] != pid)
+	{
+		++i;
+	}
+	if (i == job->n_pids) // Not found.
+	{
+		return false;
+	}
+
+	if (WIFSTOPPED (status))
+	{
+		job->state = JOB_STOPPED;
+		job->notified = false;
+	}
+	else if (WIFCONTINUED (status))
+	{
+		job->state = JOB_RUNNING;
+	}
+	else // Exited or killed.
+	{
+		job->pids[i] = 0;
+		if (i + 1 == job->n_pids)
+		{
+			job->status = status;
+		}
+
+		if (!--(job->n_running))
+		{
+			job->state = JOB_DONE;
+			job->notified = false;
+		}
+	}
+
+	return true;
+}
+
+static void
+shell_remove_job (void *self, const job_t *job)
+{
+	const Array *jobs = shell_get_jobs (self);
+	for (size_t i = 0, n = array_get_size (jobs); i < n; ++i)
+	{
+		if (array_get (jobs, i) == job)
+		{
+			array_remove_at (SHELL (self)->jobs, i);
+			return;
+		}
+	}
+}
+
+static void
+shell_real_finalize (void *self)
+{
+	assert (self);
+	assert (klass);
+
+	// The history store is already up to date.
+	if (SHELL (self)->history_store)
+	{
+		object_unref (SHELL (self)->history_store);
+	}
+	shell_drop_history_index (self);
+	free (SHELL (self)->history_file);
+	clear_history ();
+
+	free (SHELL (self)->name);
+	free (SHELL (self)->prompt);
+	free (SHELL (self)->default_command);
+	free (SHELL (self)->config_dir);
+	free (SHELL (self)->command_table);
+	for (size_t i = 0; i < SHELL (self)->parse_cache_size; ++i)
+	{
+		object_unref (SHELL (self)->parse_cache[i].command_line);
+	}
+	object_unref (SHELL (self)->arena);
+	object_unref (SHELL (self)->jobs);
+	object_unref (SHELL (self)->command_stats);
+	object_unref (SHELL (self)->path_cache);
 	object_unref (SHELL (self)->commands);
 
 	object_class_get_parent (klass)->finalize (self);
@@ -21,17 +21,42 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/types.h>
 
 #include <readline/readline.h>
 #include <readline/history.h>
 
+#include "arena.h"
 #include "assert.h"
 #include "array.h"
+#include "command_line.h"
+#include "histogram.h"
+#include "history_index.h"
+#include "history_store.h"
 #include "object.h"
+#include "string.h"
+#include "path_cache.h"
+#include "usage.h"
 
 #define DEFAULT_COMMAND "execfg"
 #define DEFAULT_PROMPT "\001\033[31;1m\002>\001\033[0m\002 "
 
+/**
+ * The maximum number of command lines kept by shell_parse ().
+ */
+#define SHELL_PARSE_CACHE_SIZE 64
+
+/**
+ * The length from which the command lines are not kept by shell_parse ().
+ */
+#define SHELL_PARSE_CACHE_MAX_LENGTH 4096
+
+/**
+ * The number of hashes of command lines parsed once remembered by
+ * shell_parse () (a power of 2).
+ */
+#define SHELL_PARSE_SEEN_SIZE 256
+
 typedef struct Shell Shell;
 typedef struct ShellClass ShellClass;
 
@@ -101,8 +126,123 @@ typedef struct
 	 * String containing the arguments list, or NULL if none.
 	 **/
 	char *args_list;
+
+	/**
+	 * The hash of the name, computed once when the command is registered.
+	 **/
+	size_t hash;
+
+	/**
+	 * True if the command accepts a pipeline as arguments (i.e. arguments
+	 * containing NULL items, see shell_parse_command_line ()).
+	 **/
+	bool pipelines;
 } command_t;
 
+/**
+ * The states of a job.
+ **/
+typedef enum
+{
+	JOB_RUNNING,
+	JOB_STOPPED,
+	JOB_DONE
+} job_state;
+
+/**
+ * This type represents a program or a pipeline started in background.
+ **/
+typedef struct
+{
+	/**
+	 * The number which identifies the job in the shell.
+	 **/
+	unsigned int id;
+
+	/**
+	 * The process group of the job.
+	 **/
+	pid_t pgid;
+
+	/**
+	 * The pids of the programs of the job, 0 for those which have been reaped.
+	 **/
+	pid_t *pids;
+
+	/**
+	 * The number of items of @pids.
+	 **/
+	size_t n_pids;
+
+	/**
+	 * The number of programs which have not been reaped yet.
+	 **/
+	size_t n_running;
+
+	/**
+	 * The status of the last program of the job (when it has been reaped).
+	 **/
+	int status;
+
+	/**
+	 * The current state.
+	 **/
+	job_state state;
+
+	/**
+	 * True if the user has been notified of the current state.
+	 **/
+	bool notified;
+
+	/**
+	 * The command line of the job.
+	 **/
+	char *command;
+} job_t;
+
+/**
+ * The durations of the command lines executing a command.
+ */
+typedef struct
+{
+	/**
+	 * The name of the builtin or of the program, or the names of the programs
+	 * of a pipeline separated by " | ".
+	 */
+	char *name;
+
+	/**
+	 * The hash of @name (see string_hash ()).
+	 */
+	size_t hash;
+
+	/**
+	 * The durations in microseconds.
+	 */
+	Histogram *histogram;
+} command_stat_t;
+
+/**
+ * An entry of the cache of shell_parse ().
+ */
+typedef struct
+{
+	/**
+	 * The hash of the text of @command_line.
+	 */
+	size_t hash;
+
+	/**
+	 * The value of the parse clock of the Shell when the entry was last used.
+	 */
+	unsigned long last_use;
+
+	/**
+	 * An owned reference to the parsed command line.
+	 */
+	CommandLine *command_line;
+} parse_cache_entry_t;
+
 /**
  * Represents an instance of the Shell type.
  */
@@ -132,16 +272,131 @@ struct Shell {
 	 */
 	Array *commands;
 
+	/**
+	 * Open addressing hash table (linear probing) of unowned references to the
+	 * items of @commands, used by shell_get_command ().
+	 */
+	const command_t **command_table;
+
+	/**
+	 * The number of slots of @command_table (always a power of 2).
+	 */
+	size_t command_table_capacity;
+
+	/**
+	 * The command named @default_command or NULL if it has not been looked up
+	 * yet.
+	 */
+	const command_t *default_command_cache;
+
+	/**
+	 * The command lines recently parsed by shell_parse (), the least recently
+	 * used one being replaced when it is full.
+	 */
+	parse_cache_entry_t parse_cache[SHELL_PARSE_CACHE_SIZE];
+
+	/**
+	 * The number of used entries of @parse_cache.
+	 */
+	size_t parse_cache_size;
+
+	/**
+	 * Incremented by each call to shell_parse ().
+	 */
+	unsigned long parse_clock;
+
+	/**
+	 * The hashes of the command lines parsed once, indexed by their low bits. A
+	 * command line only enters @parse_cache when it is parsed again, the other
+	 * ones are built in @arena.
+	 */
+	size_t parse_seen[SHELL_PARSE_SEEN_SIZE];
+
+	/**
+	 * Holds the command line parsed by shell_parse () which is not kept in
+	 * @parse_cache, until it is destroyed.
+	 */
+	Arena *arena;
+
+	/**
+	 * Array of job_t, sorted by id.
+	 */
+	Array *jobs;
+
+	/**
+	 * True if the shell reads its commands from a user.
+	 */
+	bool interactive;
+
+	/**
+	 * The locations of the programs executed from this shell.
+	 */
+	PathCache *path_cache;
+
 	/**
 	 * The configuration directory of the shell (usually $HOME/.config/@name/).
 	 */
 	char *config_dir;
 
 	/**
-	 * The file which contains the history (@config_dir/history).
+	 * The text file which contained the history before @history_store
+	 * (@config_dir/history), imported in it if it does not exist.
 	 */
 	char *history_file;
 
+	/**
+	 * Where the command lines entered are stored (@config_dir/history.bin), or
+	 * NULL if it is not used yet.
+	 */
+	HistoryStore *history_store;
+
+	/**
+	 * True if the command lines of @history_store have been added to the
+	 * history of readline.
+	 */
+	bool history_loaded;
+
+	/**
+	 * The process compacting @history_store, or 0 if there is none.
+	 */
+	pid_t history_compact_pid;
+
+	/**
+	 * The index of the command lines of @history_store used to search them,
+	 * or NULL if it is not built yet.
+	 */
+	HistoryIndex *history_index;
+
+	/**
+	 * True if readline has been initialized for this shell, which is only done
+	 * by the first call to shell_get_command_line ().
+	 */
+	bool readline_initialized;
+
+	/**
+	 * The resources used by the last command line which has run programs.
+	 */
+	usage_t last_usage;
+
+	/**
+	 * The duration in milliseconds from which the resources used by a command
+	 * line are printed after it, or -1 to never print them.
+	 */
+	long report_time;
+
+	/**
+	 * Array of command_stat_t: the durations of the command lines executed
+	 * since the start or since they were last saved (see
+	 * shell_save_command_stats ()).
+	 */
+	Array *command_stats;
+
+	/**
+	 * True if the resources used by the command line being executed have
+	 * already been printed (see shell_print_usage ()).
+	 */
+	bool usage_printed;
+
 	/**
 	 * True if the shell has been stop, else false.
 	 */
@@ -190,8 +445,94 @@ void
 shell_add_command (const void *self, const char *name, func_cmd_t function,
 	const char *args_list, const char *help);
 
+/**
+ * Same as shell_add_command () but the command accepts pipelines as arguments.
+ */
+void
+shell_add_pipeline_command (const void *self, const char *name,
+	func_cmd_t function, const char *args_list, const char *help);
+
+/**
+ * Registers a job, started in background or in foreground to be waited for by
+ * shell_wait_job ().
+ *
+ * @param self    The Shell.
+ * @param pgid    The process group of the job.
+ * @param pids    The pids of the programs of the job.
+ * @param n       The number of items of "pids".
+ * @param command The command line of the job (must not be NULL).
+ *
+ * @return The job.
+ */
+job_t *
+shell_add_job (void *self, pid_t pgid, const pid_t *pids, size_t n,
+	const char *command);
+
+/**
+ * Executes a parsed command line.
+ *
+ * If its first word is the name of an internal command, the command is called
+ * with the following words, otherwise the default command is called with all
+ * of them. The command line is not modified.
+ *
+ * @param self         The Shell.
+ * @param command_line The command line (must not be empty).
+ * @param status       Where to store the value returned by the command, or
+ *                     NULL.
+ *
+ * @return -1 if there is no command to call, 0 otherwise.
+ */
+/**
+ * Clears the history, including the history store.
+ *
+ * @param self The Shell.
+ */
+void
+shell_clear_history (void *self);
+
+int
+shell_execute_command_line (void *self, CommandLine *command_line,
+	int *status);
+
+/**
+ * Executes a command given as words, such as the arguments of a command which
+ * runs another one.
+ *
+ * @param self   The Shell.
+ * @param words  The words, NULL items separating the commands of a pipeline
+ *               (must not be empty).
+ * @param status If not NULL, will contain the status of the command.
+ *
+ * @return 0 if success, -1 if there is no command to execute it.
+ */
+int
+shell_execute_words (void *self, Array *words, int *status);
+
+/**
+ * Reads command lines from "fd" until its end or until the shell is stopped
+ * and executes them, without using readline nor the history.
+ *
+ * The input is read by large blocks and empty lines or lines starting with a
+ * '#' are ignored.
+ *
+ * @param self   The Shell.
+ * @param fd     The file descriptor to read.
+ * @param status If not NULL, will contain the status of the last command.
+ *
+ * @return 0 if success, -1 if a read error occured.
+ */
 int
-shell_execute_command_line (void *self, Array *command_line, int *status);
+shell_execute_fd (void *self, int fd, int *status);
+
+/**
+ * Executes each line of "string" such as shell_execute_fd () does.
+ *
+ * @param self   The Shell.
+ * @param string The command lines (must not be NULL).
+ * @param status If not NULL, will contain the status of the last command.
+ */
+void
+shell_execute_string (void *self, const char *string, int *status);
 
 const char *
 shell_get_config_dir (void *self);
@@ -199,30 +540,194 @@ shell_get_config_dir (void *self);
 const command_t *
 shell_get_command (const void *self, const char *name);
 
-Array *
+/**
+ * Reads a command line with readline, adds it to the history (and appends it to
+ * the history store at once) and parses it with shell_parse ().
+ *
+ * Readline is initialized and its history is filled from the history store on
+ * the first call, so that a shell which is not interactive does not pay for
+ * them. On the next ones, the command lines appended to the history store by the
+ * other shells since then are added to it.
+ *
+ * @param self The Shell.
+ *
+ * @return An owned reference to the command line or NULL if it is empty.
+ */
+CommandLine *
 shell_get_command_line (void *self);
 
 static inline const Array *
 shell_get_commands (const void *self);
 
-static inline const command_t *
-shell_get_default_command (const void *self);
+const command_t *
+shell_get_default_command (void *self);
 
 const char *
 shell_get_history_file (void *self);
 
+/**
+ * Returns the index used to search the history, which is built from the
+ * history store on the first call and then kept up to date.
+ *
+ * @param self The Shell.
+ *
+ * @return An unowned reference to the HistoryIndex.
+ */
+HistoryIndex *
+shell_get_history_index (void *self);
+
+/**
+ * Returns the store of the history, which is located in the configuration
+ * directory.
+ *
+ * @param self The Shell.
+ *
+ * @return An unowned reference to the HistoryStore, or NULL if there is no
+ *         configuration directory.
+ */
+HistoryStore *
+shell_get_history_store (void *self);
+
+/**
+ * Returns the job "id" or, if "id" is 0, the most recent one.
+ *
+ * @param self The Shell.
+ * @param id   The job number.
+ *
+ * @return The job or NULL if not found.
+ */
+job_t *
+shell_get_job (const void *self, unsigned int id);
+
+static inline const Array *
+shell_get_jobs (const void *self);
+
+static inline PathCache *
+shell_get_path_cache (const void *self);
+
 static inline const char *
 shell_get_name (const void *self);
 
 static inline const char *
 shell_get_prompt (const void *self);
 
+/**
+ * Prints the number, the state and the command line of the job.
+ *
+ * @param self The Shell.
+ * @param job  The job (must not be NULL).
+ */
+void
+shell_print_job (const void *self, const job_t *job);
+
+/**
+ * Returns the durations of the command lines executed by each command,
+ * including the ones saved by shell_save_command_stats ().
+ *
+ * @param self The Shell.
+ *
+ * @return An owned reference to an Array of command_stat_t.
+ */
+Array *
+shell_get_command_stats (void *self);
+
+/**
+ * Returns the resources used by the last command line which has run programs.
+ *
+ * @param self The Shell.
+ *
+ * @return The resources, whose @n_programs is 0 if no program has been run.
+ */
+static inline const usage_t *
+shell_get_last_usage (const void *self);
+
+static inline long
+shell_get_report_time (const void *self);
+
+/**
+ * Prints to stderr the resources used during a period, and remembers they are
+ * printed so that they are not printed again at the end of the command line.
+ *
+ * @param self  The Shell.
+ * @param usage The period.
+ */
+void
+shell_print_usage (void *self, const usage_t *usage);
+
 static inline bool
 shell_is_done (const void *self);
 
+static inline bool
+shell_is_interactive (const void *self);
+
+/**
+ * Adds the lines of a text file to the history and to the history store.
+ *
+ * @param self The Shell.
+ * @param file The path of the text file.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+shell_import_history (void *self, const char *file);
+
+/**
+ * Forgets the durations of the command lines, including the saved ones.
+ *
+ * @param self The Shell.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+shell_reset_command_stats (void *self);
+
+/**
+ * Adds the durations of the command lines executed since the last call to the
+ * ones saved in the configuration directory, so that they are kept across
+ * sessions. Nothing is done unless they have been saved before or "create" is
+ * true.
+ *
+ * @param self   The Shell.
+ * @param create True to save them even if they have never been saved.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+shell_save_command_stats (void *self, bool create);
+
+/**
+ * Stops saving the durations of the command lines, removing the saved ones.
+ *
+ * @param self The Shell.
+ *
+ * @return 0 on success, -1 on error (errno is set).
+ */
+int
+shell_unsave_command_stats (void *self);
+
+/**
+ * Parses a command line.
+ *
+ * The Shell keeps the last SHELL_PARSE_CACHE_SIZE command lines shorter than
+ * SHELL_PARSE_CACHE_MAX_LENGTH parsed at least twice, so a command line which is repeated is not parsed again: the
+ * same CommandLine is returned each time, so it must not be modified. The
+ * other command lines are built in the arena of the Shell, which is released
+ * at once when the CommandLine is destroyed, so they do not call malloc ().
+ *
+ * @param self     The Shell.
+ * @param cmd_line The command line.
+ *
+ * @return An owned reference to the parsed command line.
+ */
+CommandLine *
+shell_parse (void *self, const char *cmd_line);
+
 /**
  * Class method which parse a given command line.
  *
+ * The unquoted and unescaped '|' characters separate the commands of a
+ * pipeline, they are represented by NULL items in the result.
+ *
  * @param cmd_line The command line.
  *
  * @return The command line parsed.
@@ -230,15 +735,60 @@ shell_is_done (const void *self);
 Array *
 shell_parse_command_line(const char *cmd_line);
 
+/**
+ * Restarts a stopped shell. Readline is initialized again and the history is
+ * read again by the next call to shell_get_command_line ().
+ *
+ * @param self The Shell.
+ */
 void
 shell_reset (void *self);
 
-static inline void
+void
 shell_set_default_command (void *self, const char *name);
 
+static inline void
+shell_set_interactive (void *self, bool interactive);
+
+/**
+ * Sets the duration from which the resources used by a command line which
+ * runs programs are printed after it.
+ *
+ * @param self        The Shell.
+ * @param report_time The duration in milliseconds, or -1 to never print them.
+ */
+static inline void
+shell_set_report_time (void *self, long report_time);
+
 static inline void
 shell_stop (void *self);
 
+/**
+ * Reaps the background programs which have changed of state, removes the jobs
+ * which are done and, if the shell is interactive, notifies the user of these
+ * changes.
+ *
+ * Nothing is done if no SIGCHLD has been received since the last call.
+ *
+ * @param self The Shell.
+ */
+void
+shell_update_jobs (void *self);
+
+/**
+ * Waits until the job is done or stopped. If it is done, it is removed. If the
+ * job has the terminal, the shell takes it back.
+ *
+ * @param self       The Shell.
+ * @param job        The job.
+ * @param foreground If true, the terminal is given to the job while waiting.
+ *
+ * @return The status of the last program of the job or -1 if it has been
+ *         stopped.
+ */
+int
+shell_wait_job (void *self, job_t *job, bool foreground);
+
 
 // Inline functions:
 
@@ -250,12 +800,20 @@ shell_get_commands (const void *self)
 	return SHELL (self)->commands;
 }
 
-static inline const command_t *
-shell_get_default_command (const void *self)
+static inline PathCache *
+shell_get_path_cache (const void *self)
 {
 	assert (self);
 
-	return shell_get_command (self, SHELL (self)->default_command);
+	return SHELL (self)->path_cache;
+}
+
+static inline const Array *
+shell_get_jobs (const void *self)
+{
+	assert (self);
+
+	return SHELL (self)->jobs;
 }
 
 static inline const char *
@@ -274,6 +832,22 @@ shell_get_prompt (const void *self)
 	return SHELL (self)->prompt;
 }
 
+static inline const usage_t *
+shell_get_last_usage (const void *self)
+{
+	assert (self);
+
+	return &SHELL (self)->last_usage;
+}
+
+static inline long
+shell_get_report_time (const void *self)
+{
+	assert (self);
+
+	return SHELL (self)->report_time;
+}
+
 static inline bool
 shell_is_done (const void *self)
 {
@@ -282,6 +856,14 @@ shell_is_done (const void *self)
 	return SHELL (self)->done;
 }
 
+static inline bool
+shell_is_interactive (const void *self)
+{
+	assert (self);
+
+	return SHELL (self)->interactive;
+}
+
 static inline Shell *
 shell_new (const char *name)
 {
@@ -295,12 +877,19 @@ shell_new_with_prompt (const char *name, const char *prompt)
 }
 
 static inline void
-shell_set_default_command (void *self, const char *name)
+shell_set_interactive (void *self, bool interactive)
+{
+	assert (self);
+
+	SHELL (self)->interactive = interactive;
+}
+
+static inline void
+shell_set_report_time (void *self, long report_time)
 {
 	assert (self);
-	assert (name);
 
-	SHELL (self)->default_command = strdup (name);
+	SHELL (self)->report_time = report_time;
 }
 
 static inline void
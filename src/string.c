@@ -1,6 +1,8 @@
 #include "string.h"
 
 #include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -8,13 +10,88 @@
 #include "debug.h"
 #include "object.h"
 
-#define INITIAL_CAPACITY 16
-
 /**
- * Used by string_from_integer and string_from_uinteger.
+ * Used by string_append_uinteger.
  */
 static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 
+/**
+ * The decimal representations of the numbers from 0 to 99, used to write two
+ * digits at once.
+ */
+static const char digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+/**
+ * Returns the number of digits of "n" in base "base".
+ */
+static inline size_t
+count_digits (uint64_t n, unsigned char base)
+{
+	size_t count = 1;
+	if (10 == base)
+	{
+		for (;;)
+		{
+			if (n < 10)
+			{
+				return count;
+			}
+			if (n < 100)
+			{
+				return count + 1;
+			}
+			if (n < 1000)
+			{
+				return count + 2;
+			}
+			if (n < 10000)
+			{
+				return count + 3;
+			}
+			n /= 10000;
+			count += 4;
+		}
+	}
+
+	while (n >= base)
+	{
+		n /= base;
+		++count;
+	}
+	return count;
+}
+
+/**
+ * Returns true if the content of the String is stored in the String itself.
+ */
+static inline bool
+string_is_inline (const String *self)
+{
+	return self->string == self->buffer;
+}
+
+/**
+ * Makes the String empty and uses its inline buffer.
+ */
+static inline void
+string_reset_inline (String *self)
+{
+	self->capacity = STRING_INLINE_CAPACITY;
+	self->length = 0;
+	self->string = self->buffer;
+	self->buffer[0] = '\0';
+}
+
 static void
 string_real_finalize (void *);
 
@@ -60,21 +137,21 @@ string_construct (size_t size, void *klass, const char *chars)
 
 	String *self =  STRING (object_construct (size, klass));
 
+	string_reset_inline (self);
+
 	if (chars && *chars) // Not empty
 	{
-		self->length = strlen (chars);
-		self->capacity = self->length + 1;
+		size_t length = strlen (chars);
+		if (length >= STRING_INLINE_CAPACITY) // Too long for the buffer.
+		{
+			self->capacity = length + 1;
 
-		self->string = malloc (sizeof (char) * self->capacity);
-		assert (self->string);
+			self->string = malloc (sizeof (char) * self->capacity);
+			assert (self->string);
+		}
 
-		memcpy (self->string, chars, self->length);
-	}
-	else
-	{
-		self->capacity = 0;
-		self->length = 0;
-		self->string = NULL;
+		memcpy (self->string, chars, length + 1);
+		self->length = length;
 	}
 
 	return self;
@@ -116,6 +193,71 @@ string_append_char (void *self, char c)
 	STRING (self)->string[STRING (self)->length] = 0;
 }
 
+void
+string_append_integer (void *self, int64_t n, unsigned char base)
+{
+	assert (self);
+
+	if (n < 0)
+	{
+		string_append_char (self, '-');
+
+		// The negation is done on the unsigned type to handle INT64_MIN.
+		string_append_uinteger (self, -(uint64_t) n, base);
+	}
+	else
+	{
+		string_append_uinteger (self, (uint64_t) n, base);
+	}
+}
+
+void
+string_append_uinteger (void *self, uint64_t n, unsigned char base)
+{
+	assert (self);
+	assert_cmpuint (base, >=, 2);
+	assert_cmpuint (base, <=, 36);
+
+	size_t length = STRING (self)->length + count_digits (n, base);
+	string_ensure_capacity (self, length + 1);
+
+	// The digits are written from the last one.
+	char *p = STRING (self)->string + length;
+	*p = '\0';
+
+	if (10 == base)
+	{
+		while (n >= 100)
+		{
+			const char *pair = digit_pairs + ((n % 100) << 1);
+			n /= 100;
+
+			*--p = pair[1];
+			*--p = pair[0];
+		}
+		if (n >= 10)
+		{
+			const char *pair = digit_pairs + (n << 1);
+
+			*--p = pair[1];
+			*--p = pair[0];
+		}
+		else
+		{
+			*--p = digits[n];
+		}
+	}
+	else
+	{
+		do
+		{
+			*--p = digits[n % base];
+		} while ( (n /= base) );
+	}
+
+	STRING (self)->length = length;
+}
+
 char *
 string_concat (char *dest, ...)
 {
@@ -185,55 +327,53 @@ string_ensure_capacity (void *self, size_t capacity)
 		return;
 	}
 
-	size_t new_capacity;
-	if (STRING (self)->capacity == 0)
+	size_t new_capacity = STRING (self)->capacity << 1;
+	while (new_capacity < capacity)
 	{
-		new_capacity = INITIAL_CAPACITY;
+		new_capacity <<= 1;
 	}
-	else
+
+	char *p;
+	if (string_is_inline (self)) // Moves the content out of the String.
 	{
-		new_capacity = STRING (self)->capacity << 1;
-	}
+		p = (char *) malloc (sizeof (char) * new_capacity);
+		assert (p);
 
-	while (new_capacity < capacity)
+		memcpy (p, STRING (self)->buffer, STRING (self)->length + 1);
+	}
+	else
 	{
-		new_capacity <<= 1;
+		p = (char *) realloc (STRING (self)->string, sizeof (char) * new_capacity);
+		assert (p);
 	}
 
-	char *p = (char *) realloc (STRING (self)->string, sizeof (char) * new_capacity);
-	assert (p);
-
 	STRING (self)->string = p;
 	STRING (self)->capacity = new_capacity;
 
 	debug ("New String capacity: %u", new_capacity);
 }
 
-String *
-string_from_integer (int n, unsigned char base)
+size_t
+string_hash (const char *chars)
 {
-	assert_cmpuint (base, >=, 2);
-	assert_cmpuint (base, <=, 36);
-
-	String *s = string_new ();
-	bool neg = false;
+	assert (chars);
 
-	if (n < 0)
+	uint64_t hash = 14695981039346656037ULL;
+	while (*chars)
 	{
-		neg = true;
-		n = -n;
+		hash ^= (unsigned char) *chars++;
+		hash *= 1099511628211ULL;
 	}
 
-	do
-	{
-		string_append_char (s, digits[n % base]);
-	} while ( (n /= base) );
+	return (size_t) hash;
+}
+
+String *
+string_from_integer (int64_t n, unsigned char base)
+{
+	String *s = string_new ();
+	string_append_integer (s, n, base);
 
-	if (neg)
-	{
-		string_append_char (s, '-');
-	}
-	string_reverse (s);
 	return s;
 }
 
@@ -255,13 +395,27 @@ string_steal (void *self)
 {
 	assert (self);
 
-	string_trim_size (self);
+	if (!STRING (self)->length)
+	{
+		string_trim_size (self);
+		return NULL;
+	}
+
+	char *content;
+	if (string_is_inline (self))
+	{
+		content = malloc (sizeof (char) * (STRING (self)->length + 1));
+		assert (content);
 
-	char *content = STRING (self)->string;
+		memcpy (content, STRING (self)->buffer, STRING (self)->length + 1);
+	}
+	else
+	{
+		string_trim_size (self);
+		content = STRING (self)->string;
+	}
 
-	STRING (self)->capacity = 0;
-	STRING (self)->length = 0;
-	STRING (self)->string = NULL;
+	string_reset_inline (self);
 
 	return content;
 }
@@ -271,44 +425,37 @@ string_trim_size (void *self)
 {
 	assert (self);
 
+	if (string_is_inline (self)) // We cannot do more.
+	{
+		return;
+	}
+
 	size_t length = string_get_length (self);
-	if (length) // The string is not empty.
+	if (length < STRING_INLINE_CAPACITY) // Fits in the buffer.
 	{
-		size_t new_capacity = length + 1;
+		memcpy (STRING (self)->buffer, STRING (self)->string, length + 1);
+		free (STRING (self)->string);
 
-		if (new_capacity == string_get_capacity (self)) // We cannot do more.
-		{
-			return;
-		}
+		STRING (self)->string = STRING (self)->buffer;
+		STRING (self)->capacity = STRING_INLINE_CAPACITY;
+	}
+	else if (length + 1 != string_get_capacity (self))
+	{
+		size_t new_capacity = length + 1;
 
 		STRING (self)->string = realloc (STRING (self)->string, sizeof (char) * new_capacity);
 		assert (STRING (self)->string);
 
 		STRING (self)->capacity = new_capacity;
 	}
-	else if (STRING (self)->string)
-	{
-		free (STRING (self)->string);
-
-		STRING (self)->string = NULL;
-		STRING (self)->capacity = 0;
-	}
 }
 
 String *
-string_from_uinteger (unsigned int n, unsigned char base)
+string_from_uinteger (uint64_t n, unsigned char base)
 {
-	assert_cmpuint (base, >=, 2);
-	assert_cmpuint (base, <=, 36);
-
 	String *s = string_new ();
+	string_append_uinteger (s, n, base);
 
-	do
-	{
-		string_append_char (s, digits[n % base]);
-	} while ( (n /= base) );
-
-	string_reverse (s);
 	return s;
 }
 
@@ -317,7 +464,10 @@ string_real_finalize (void *self)
 {
 	assert (self);
 
-	free (STRING (self)->string);
+	if (!string_is_inline (self))
+	{
+		free (STRING (self)->string);
+	}
 
 	assert (klass);
 	object_class_get_parent (klass)->finalize (self);
@@ -18,6 +18,7 @@
 #ifndef STRING_H
 #define STRING_H
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -67,6 +68,12 @@ string_class_allocate (size_t size, void *parent, char *name);
 StringClass *
 string_class_get (void);
 
+/**
+ * The number of characters (trailing '\0' included) a String can contain
+ * without allocating memory.
+ */
+#define STRING_INLINE_CAPACITY 24
+
 /**
  * Represents an instance of the String type.
  */
@@ -85,9 +92,14 @@ struct String {
 	size_t length;
 
 	/**
-	 * The content.
+	 * The content (never NULL), either @buffer or an allocated memory space.
 	 */
 	char *string;
+
+	/**
+	 * Holds the content as long as it fits.
+	 */
+	char buffer[STRING_INLINE_CAPACITY];
 };
 
 /**
@@ -158,10 +170,18 @@ void
 string_append_char (void *self, char c);
 
 /**
- * TODO: write doc
+ * Appends the string representation of the integer "n" to the String.
+ *
+ * The digits are directly written in the String, no temporary object is
+ * allocated.
+ *
+ * @param self The String.
+ * @param n    The integer.
+ * @param base The base with which the integer should be written (from 2 to
+ *             36).
  */
-static inline void
-string_append_integer (void *self, int n, unsigned char base);
+void
+string_append_integer (void *self, int64_t n, unsigned char base);
 
 /**
  * Appends the content of "string" to the String.
@@ -173,10 +193,18 @@ static inline void
 string_append_string (void *self, void *string);
 
 /**
- * TODO: write doc
+ * Appends the string representation of the unsigned integer "n" to the String.
+ *
+ * The digits are directly written in the String, no temporary object is
+ * allocated.
+ *
+ * @param self The String.
+ * @param n    The unsigned integer.
+ * @param base The base with which the unsigned integer should be written (from
+ *             2 to 36).
  */
-static inline void
-string_append_uinteger (void *self, unsigned int n, unsigned char base);
+void
+string_append_uinteger (void *self, uint64_t n, unsigned char base);
 
 /**
  * Clears the String (i.e. sets its length to 0).
@@ -202,6 +230,16 @@ string_clear (void *self);
 char *
 string_concat (char *dest, ...);
 
+/**
+ * Static method which computes the hash (FNV-1a) of a '\0' terminated string.
+ *
+ * @param chars The string (must not be NULL).
+ *
+ * @return The hash.
+ */
+size_t
+string_hash (const char *chars);
+
 /**
  * Increases the String's capacity if necessary to ensure that it can hold
  * "capacity" characters (including the trailing '\0').
@@ -214,10 +252,16 @@ void
 string_ensure_capacity (void *self, size_t capacity);
 
 /**
- * TODO: write doc
+ * Creates a new String which will contain the string representation
+ * of the integer @n.
+ *
+ * @param n    The integer.
+ * @param base The base with wich the integer should be written.
+ *
+ * @return The new String.
  */
 String *
-string_from_integer (int n, unsigned char base);
+string_from_integer (int64_t n, unsigned char base);
 
 /**
  * Returns the capacity of the String.
@@ -288,11 +332,13 @@ string_set_char (void *self, size_t index, char c);
 /**
  * Steals the content of the String.
  *
- * The String will be empty.
+ * The String will be empty. If the content is stored in the String itself, a
+ * copy is allocated.
  *
  * @param self The String.
  *
- * @return The previous String's content or NULL if there wasn't.
+ * @return The previous String's content, which should be freed when no longer
+ *         needed, or NULL if there wasn't.
  */
 char *
 string_steal (void *self);
@@ -316,7 +362,7 @@ string_trim_size (void *self);
  * @return The new String.
  */
 String *
-string_from_uinteger (unsigned int n, unsigned char base);
+string_from_uinteger (uint64_t n, unsigned char base);
 
 // Inline functions:
 
@@ -338,28 +384,6 @@ string_append (void *self, const char *chars)
 	string_append_n (self, chars, strlen (chars));
 }
 
-static inline void
-string_append_integer (void *self, int n, unsigned char base)
-{
-	assert (self);
-
-	String *s = string_from_integer (n, base);
-	string_append_string (self, s);
-
-	object_unref (s);
-}
-
-static inline void
-string_append_uinteger (void *self, unsigned int n, unsigned char base)
-{
-	assert (self);
-
-	String *s = string_from_uinteger (n, base);
-	string_append_string (self, s);
-
-	object_unref (s);
-}
-
 static inline void
 string_append_string (void *self, void *string)
 {
@@ -373,11 +397,8 @@ string_clear (void *self)
 {
 	assert (self);
 
-	if (STRING (self)->length) // The string is allocated and not empty.
-	{
-		STRING (self)->length = 0;
-		STRING (self)->string[0] = 0;
-	}
+	STRING (self)->length = 0;
+	STRING (self)->string[0] = 0;
 }
 
 static inline size_t
@@ -401,12 +422,7 @@ string_get_chars (const void *self)
 {
 	assert (self);
 
-	if (STRING (self)->string)
-	{
-		return STRING (self)->string;
-	}
-
-	return "";
+	return STRING (self)->string;
 }
 
 static inline size_t
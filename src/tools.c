@@ -18,6 +18,8 @@
 #include <errno.h>
 #include <error.h>
 #include <pwd.h>
+#include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -32,7 +34,28 @@
 #include "tools.h"
 
 #include "array.h"
+#include "assert.h"
+#include "profile.h"
 #include "string.h"
+#include "usage.h"
+
+/**
+ * The interpreter of the files which are not recognized as executables.
+ **/
+#define SCRIPT_INTERPRETER "/bin/sh"
+
+extern char **environ;
+
+static spawn_backend backend = SPAWN_POSIX;
+
+static pid_t
+execute_posix_spawn (const char *file, void **args);
+
+static pid_t
+execute_fork (const char *file, void **args);
+
+static void
+get_default_signals (sigset_t *signals);
 
 static void cleaner (int i, void *ptr)
 {
@@ -61,38 +84,93 @@ get_passwd_info (void)
 pid_t
 execute (const char *file, void **args, exec_mode mode, int *status)
 {
-	pid_t pid;
-	if (EXEC_REPLACE != mode)
-	{
-		pid = fork ();
-		if (-1 == pid) // The fork failed.
-		{
-			return -1;
-		}
-	}
-	else
-	{
-		pid = 0;
-	}
-	if (!pid) // If we are in the child or the EXEC_REPLACE is active.
+	if (EXEC_REPLACE == mode)
 	{
 		void *arr = array_get_array (args, true);
 		execvp (file, arr);
 		free (arr); // If there was an error, we must free arr.
-		if (EXEC_REPLACE == mode)
-		{
-			return -1;
-		}
-		error (EXIT_FAILURE, errno, "Error");
+		return -1;
 	}
+
+	// Our buffered output must come before the child's one.
+	fflush (stdout);
+
+	uint64_t start = profile_now ();
+	pid_t pid = (SPAWN_POSIX == backend ? execute_posix_spawn (file, args)
+		: execute_fork (file, args));
+	if (-1 == pid)
+	{
+		return -1;
+	}
+	profile_add (PROFILE_SPAWN, start);
 	if (EXEC_BG == mode) // The program is run in bakground.
 	{
 		return pid;
 	}
-	waitpid (pid, status, 0);
+
+	start = profile_now ();
+	usage_wait (pid, status, 0);
+	profile_add (PROFILE_WAIT, start);
 	return pid;
 }
 
+void
+set_spawn_backend (spawn_backend new_backend)
+{
+	backend = new_backend;
+}
+
+spawn_backend
+get_spawn_backend (void)
+{
+	return backend;
+}
+
+int
+spawn_program (pid_t *pid, const char *file,
+	const posix_spawn_file_actions_t *actions,
+	const posix_spawnattr_t *attributes, char *const *argv)
+{
+	assert (argv && argv[0]);
+
+	if (!strchr (file, '/'))
+	{
+		return posix_spawnp (pid, file, actions, attributes, argv, environ);
+	}
+
+	int err = posix_spawn (pid, file, actions, attributes, argv, environ);
+	if (ENOEXEC != err)
+	{
+		return err;
+	}
+
+	// Runs "/bin/sh file args..." as execvp () does.
+	size_t n = get_args_lg ((const char *const *) argv);
+	char **script_argv = malloc (sizeof (char *) * (n + 2));
+	if (!script_argv)
+	{
+		return ENOMEM;
+	}
+	script_argv[0] = (char *) SCRIPT_INTERPRETER;
+	script_argv[1] = (char *) file;
+	memcpy (script_argv + 2, argv + 1, sizeof (char *) * n);
+	err = posix_spawn (pid, SCRIPT_INTERPRETER, actions, attributes,
+		script_argv, environ);
+	free (script_argv);
+	return err;
+}
+
+void
+init_spawn_attributes (posix_spawnattr_t *attributes, short flags)
+{
+	posix_spawnattr_init (attributes);
+
+	sigset_t signals;
+	get_default_signals (&signals);
+	posix_spawnattr_setsigdefault (attributes, &signals);
+	posix_spawnattr_setflags (attributes, flags | POSIX_SPAWN_SETSIGDEF);
+}
+
 size_t
 get_args_lg (const char *const *args)
 {
@@ -140,14 +218,14 @@ get_home_dir (void)
 	static char *home_dir = NULL;
 	if (!home_dir)
 	{
-		const struct passwd *passwd = get_passwd_info ();
-		if (passwd && passwd->pw_dir)
+		const struct passwd *passwd;
+		if ( (home_dir = getenv ("HOME")) && '\0' != *home_dir )
 		{
-			home_dir = strdup (passwd->pw_dir);
+			home_dir = strdup (home_dir);
 		}
-		else if ( (home_dir = getenv ("HOME")) )
+		else if ( (passwd = get_passwd_info ()) && passwd->pw_dir )
 		{
-			home_dir = strdup (home_dir);
+			home_dir = strdup (passwd->pw_dir);
 		}
 		else
 		{
@@ -223,7 +301,76 @@ get_tmp_dir (void)
 	return tmp_dir;
 }
 
-#if !(_GNU_SOURCE || _POSIX_C_SOURCE >= 200809L)
+/**
+ * Starts "file" with spawn_program () and returns its pid, or -1 (and errno is
+ * set) if it failed.
+ *
+ * posix_spawn () does not duplicate the page tables of the shell (it uses
+ * vfork () or clone (CLONE_VM)), so its cost does not grow with our memory
+ * usage.
+ */
+static pid_t
+execute_posix_spawn (const char *file, void **args)
+{
+	pid_t pid;
+	posix_spawnattr_t attributes;
+	init_spawn_attributes (&attributes, 0);
+	void *arr = array_get_array (args, true);
+	int err = spawn_program (&pid, file, NULL, &attributes, arr);
+	free (arr);
+	posix_spawnattr_destroy (&attributes);
+	if (err) // The spawn or the execution failed.
+	{
+		errno = err;
+		return -1;
+	}
+	return pid;
+}
+
+/**
+ * Starts "file" with fork () and execvp () and returns its pid, or -1 (and
+ * errno is set) if the fork failed. A failed execution is reported by the
+ * child, which exits with EXIT_FAILURE.
+ */
+static pid_t
+execute_fork (const char *file, void **args)
+{
+	pid_t pid = fork ();
+	if (!pid) // We are in the child.
+	{
+		sigset_t signals;
+		get_default_signals (&signals);
+		for (int signal_number = 1; signal_number < NSIG; ++signal_number)
+		{
+			if (sigismember (&signals, signal_number))
+			{
+				signal (signal_number, SIG_DFL);
+			}
+		}
+
+		void *arr = array_get_array (args, true);
+		execvp (file, arr);
+		error (EXIT_FAILURE, errno, "Error");
+	}
+	return pid;
+}
+
+/**
+ * Fills "signals" with the signals which must get back their default action
+ * in the programs started by the shell.
+ */
+static void
+get_default_signals (sigset_t *signals)
+{
+	sigemptyset (signals);
+	sigaddset (signals, SIGINT);
+	sigaddset (signals, SIGQUIT);
+	sigaddset (signals, SIGTSTP);
+	sigaddset (signals, SIGTTIN);
+	sigaddset (signals, SIGTTOU);
+}
+
+#if !(defined (_GNU_SOURCE) || _POSIX_C_SOURCE >= 200809L)
 
 char *
 strndup (const char *s, size_t n)
@@ -272,4 +419,3 @@ get_cwd (void)
 }
 
 #endif
-
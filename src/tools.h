@@ -18,6 +18,7 @@
 #ifndef SHELLDON_TOOLS_H
 #define SHELLDON_TOOLS_H
 
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdlib.h>
 
@@ -28,22 +29,82 @@ typedef enum
 	EXEC_REPLACE
 } exec_mode;
 
+/**
+ * The ways execute () can start a program.
+ **/
+typedef enum
+{
+	SPAWN_POSIX, // posix_spawn (), the default.
+	SPAWN_FORK   // fork () + execvp ().
+} spawn_backend;
+
 /**
  * Executes the program @file (searched in PATH if not absolute) with @args as
  * arguments. The program can be started in background, foreground, or even
  * replaced the current process.
  *
+ * The program is started with the backend set by set_spawn_backend ().
+ *
  * @param file The program name.
  * @param args An Array containing the arguments.
  * @param mode The execution mode (background, foreground, replace).
  * @param status If not NULL and if the program is started in foreground, it
  *               will contain the return value of the child process.
- * @return The return value of fork () in EXEC_BG or EXEC_FG modes, or, in
- *         EXEC_REPLACE, -1 if we failed in starting the program.
+ * @return The pid of the child in EXEC_BG or EXEC_FG modes, or -1 (and errno
+ *         is set) if we failed in starting the program.
  **/
 pid_t
 execute (const char *file, void **args, exec_mode mode, int *status);
 
+/**
+ * Sets how execute () starts the programs. posix_spawn () does not duplicate
+ * the page tables of the shell, so its cost does not grow with the memory the
+ * shell uses, unlike the one of fork (). The pipelines are always started with
+ * posix_spawn ().
+ *
+ * @param backend The backend.
+ **/
+void
+set_spawn_backend (spawn_backend backend);
+
+/**
+ * Returns how execute () starts the programs.
+ *
+ * @return The backend.
+ **/
+spawn_backend
+get_spawn_backend (void);
+
+/**
+ * Starts the program @file with posix_spawn () (or posix_spawnp () if @file
+ * does not contain a "/"). Like execvp (), and unlike posix_spawn () since
+ * glibc 2.27, a file with a path which is not recognized as an executable
+ * (ENOEXEC) is run as a script by /bin/sh.
+ *
+ * @param pid        Where to store the pid of the child.
+ * @param file       The program.
+ * @param actions    The file actions (may be NULL).
+ * @param attributes The attributes (may be NULL).
+ * @param argv       The NULL-terminated arguments (argv[0] must not be NULL).
+ * @return 0 or an error number if the program could not be started.
+ **/
+int
+spawn_program (pid_t *pid, const char *file,
+	const posix_spawn_file_actions_t *actions,
+	const posix_spawnattr_t *attributes, char *const *argv);
+
+/**
+ * Initializes the attributes given to posix_spawn () to start a program. The
+ * signals which an interactive shell ignores (SIGINT, SIGQUIT, SIGTSTP,
+ * SIGTTIN and SIGTTOU) get back their default action in the program, so that
+ * it can be interrupted or stopped from the terminal.
+ *
+ * @param attributes The attributes, to destroy with posix_spawnattr_destroy ().
+ * @param flags      The other POSIX_SPAWN_* flags to set.
+ **/
+void
+init_spawn_attributes (posix_spawnattr_t *attributes, short flags);
+
 /**
  * Counts the number of items in a NULL-terminated vector of strings
  * (i.e. char**).
@@ -67,8 +128,9 @@ get_config_dir (void);
 
 /**
  * Returns the current user's home directory.
- * The directory is search in the password database and in the HOME environment
- * variable in that order. If none found, the value returned is get_tmp_dir ().
+ * The directory is search in the HOME environment variable and in the password
+ * database in that order (so that the latter, which may be remote, is usually
+ * not read). If none found, the value returned is get_tmp_dir ().
  *
  * @return The home directory.
  **/
@@ -104,7 +166,7 @@ get_tmp_dir (void);
 // get_current_dir_name () and strndup () are GNU extensions, so we have to define
 // them ourselves if they are not already defined.
 
-#if !(_GNU_SOURCE || _POSIX_C_SOURCE >= 200809L)
+#if !(defined (_GNU_SOURCE) || _POSIX_C_SOURCE >= 200809L)
 
 /**
  * TODO: write help.
@@ -0,0 +1,110 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "assert.h"
+#include "profile.h"
+#include "usage.h"
+
+/**
+ * The resources used by all the programs waited for so far, except @max_rss
+ * which is the largest since the current period began.
+ **/
+static usage_t total = { 0 };
+
+pid_t
+usage_wait (pid_t pid, int *status, int options)
+{
+	int wait_status;
+	struct rusage rusage;
+	pid_t result = wait4 (pid, &wait_status, options, &rusage);
+	if (result <= 0)
+	{
+		return result;
+	}
+
+	if (WIFEXITED (wait_status) || WIFSIGNALED (wait_status))
+	{
+		timeradd (&total.user, &rusage.ru_utime, &total.user);
+		timeradd (&total.system, &rusage.ru_stime, &total.system);
+		if (rusage.ru_maxrss > total.max_rss)
+		{
+			total.max_rss = rusage.ru_maxrss;
+		}
+		total.voluntary_switches += rusage.ru_nvcsw;
+		total.involuntary_switches += rusage.ru_nivcsw;
+		++total.n_programs;
+	}
+	if (status)
+	{
+		*status = wait_status;
+	}
+
+	return result;
+}
+
+void
+usage_begin (usage_t *usage)
+{
+	assert (usage);
+
+	*usage = total;
+	usage->wall = profile_now ();
+	total.max_rss = 0;
+}
+
+void
+usage_end (usage_t *usage)
+{
+	assert (usage);
+
+	usage->wall = profile_now () - usage->wall;
+	timersub (&total.user, &usage->user, &usage->user);
+	timersub (&total.system, &usage->system, &usage->system);
+	usage->voluntary_switches = total.voluntary_switches
+		- usage->voluntary_switches;
+	usage->involuntary_switches = total.involuntary_switches
+		- usage->involuntary_switches;
+	usage->n_programs = total.n_programs - usage->n_programs;
+
+	// The enclosing period gets the largest of both.
+	long max_rss = total.max_rss;
+	if (usage->max_rss > total.max_rss)
+	{
+		total.max_rss = usage->max_rss;
+	}
+	usage->max_rss = max_rss;
+}
+
+void
+usage_print (FILE *stream, const usage_t *usage)
+{
+	assert (stream);
+	assert (usage);
+
+	fprintf (stream, "real %.3fs  user %ld.%03lds  sys %ld.%03lds  max RSS %ld KiB"
+		"  switches %ld+%ld\n", (double) usage->wall / 1e9,
+		(long) usage->user.tv_sec, (long) usage->user.tv_usec / 1000,
+		(long) usage->system.tv_sec, (long) usage->system.tv_usec / 1000,
+		usage->max_rss, usage->voluntary_switches, usage->involuntary_switches);
+}
@@ -0,0 +1,100 @@
+/**
+ * This file is a part of Shelldon.
+ *
+ * Shelldon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Shelldon is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Shelldon.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SHELLDON_USAGE_H
+#define SHELLDON_USAGE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+#include <sys/types.h>
+
+/**
+ * The resources used by the programs which have ended during a period, e.g.
+ * the execution of a command line.
+ **/
+typedef struct
+{
+	/**
+	 * The duration of the period in nanoseconds.
+	 **/
+	uint64_t wall;
+
+	/**
+	 * The CPU time spent in user mode and in the kernel.
+	 **/
+	struct timeval user;
+	struct timeval system;
+
+	/**
+	 * The largest resident set size of the programs in KiB.
+	 **/
+	long max_rss;
+
+	/**
+	 * The number of times the programs have given up the CPU (e.g. to wait for
+	 * an input) and have been preempted.
+	 **/
+	long voluntary_switches;
+	long involuntary_switches;
+
+	/**
+	 * The number of programs.
+	 **/
+	unsigned int n_programs;
+} usage_t;
+
+/**
+ * Waits for a child like waitpid () does, with wait4 () so that its resource
+ * usage is added to the current periods if it has ended.
+ *
+ * @param pid     The process to wait for.
+ * @param status  If not NULL, will contain its status.
+ * @param options The options of waitpid ().
+ *
+ * @return The same as waitpid ().
+ **/
+pid_t
+usage_wait (pid_t pid, int *status, int options);
+
+/**
+ * Begins a period. Periods can be nested: each one gets the programs which
+ * have ended while it was running.
+ *
+ * @param usage Where the period is stored, to be given to usage_end ().
+ **/
+void
+usage_begin (usage_t *usage);
+
+/**
+ * Ends a period begun with usage_begin ().
+ *
+ * @param usage The period, which will contain the resources used during it.
+ **/
+void
+usage_end (usage_t *usage);
+
+/**
+ * Prints the resources used during a period on one line.
+ *
+ * @param stream Where to print.
+ * @param usage  The period.
+ **/
+void
+usage_print (FILE *stream, const usage_t *usage);
+
+#endif